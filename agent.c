@@ -0,0 +1,233 @@
+#include <poll.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "agent.h"
+
+_Static_assert(AGENT_BUFFER_SIZE > 2 * (sizeof(agent_frame) + sizeof(agent_sample) + AGENT_SESSIONS_SIZE), "agent buffer does not hold two samples");
+
+bool agentStart(agent_link* a, const char* address, long long interval){
+    /**
+    * Prepares the connection of an agent to its aggregator, the first attempt is made with the first sample
+    *
+    * @a: link to initialize
+    * @address: "HOST:PORT" or "[IPv6]:PORT" of the aggregator
+    * @interval: sampling interval of the agent in nanoseconds, sent to the aggregator
+    *
+    * The address is resolved here, once, so that a reconnect never waits for a name server in the sampling loop
+    *
+    * Return: false if the address is invalid or cannot be resolved (a message has been printed)
+    */
+
+    memset(a, 0, sizeof(agent_link));
+    a->address = address;
+    a->interval = interval;
+    a->fd = -1;
+    a->backoff = AGENT_RETRY_MIN;
+    a->session_changes = -1;
+
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL || colon == address || colon - address >= (long) sizeof(host) || colon[1] == '\0'){
+        fprintf(stderr, "Error: invalid aggregator address '%s', expected HOST:PORT\n", address);
+        return false;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    char* name = host;
+    size_t length = strlen(host);
+    if (length >= 2 && host[0] == '[' && host[length - 1] == ']'){
+        host[length - 1] = '\0';
+        name = host + 1;
+    }
+
+    struct addrinfo hints, *results;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int result = getaddrinfo(name, colon + 1, &hints, &results);
+    if (result != 0){
+        fprintf(stderr, "Error: failed to resolve aggregator address '%s'. (%s)\n", address, gai_strerror(result));
+        return false;
+    }
+    memcpy(&a->peer, results->ai_addr, results->ai_addrlen);
+    a->peer_length = results->ai_addrlen;
+    freeaddrinfo(results);
+
+    a->pending = malloc(AGENT_BUFFER_SIZE);
+    if (a->pending == NULL){
+        fprintf(stderr, "Error: failed to allocate the agent buffer\n");
+        return false;
+    }
+    return true;
+}
+
+static void disconnect(agent_link* a){
+    // Frames that were not sent are lost with the connection, the next one starts over with a hello and the session list
+    if (a->fd >= 0){ close(a->fd); }
+    a->fd = -1;
+    a->connected = false;
+    a->pending_length = 0;
+    a->sent = 0;
+    a->session_changes = -1;
+    a->retry = monotonicNow() + a->backoff;
+    a->backoff = a->backoff * 2 < AGENT_RETRY_MAX ? a->backoff * 2 : AGENT_RETRY_MAX;
+}
+
+static void markConnected(agent_link* a){
+    // A completed connect ends the backoff, whether connect returned at once or was polled later
+    a->connected = true;
+    a->backoff = AGENT_RETRY_MIN;
+}
+
+static bool queueFrame(agent_link* a, uint32_t type, const void* payload, size_t length, const void* extra, size_t extra_length){
+    /**
+    * Appends a frame to the bytes waiting for the socket
+    *
+    * Return: false if the aggregator fell so far behind that the frame does not fit, it is then dropped whole
+    */
+
+    size_t size = sizeof(agent_frame) + length + extra_length;
+    if (a->pending_length + size > AGENT_BUFFER_SIZE && a->sent > 0){
+        memmove(a->pending, a->pending + a->sent, a->pending_length - a->sent);
+        a->pending_length -= a->sent;
+        a->sent = 0;
+    }
+    if (a->pending_length + size > AGENT_BUFFER_SIZE){ return false; }
+
+    agent_frame header = { (uint32_t)(length + extra_length), type };
+    memcpy(a->pending + a->pending_length, &header, sizeof(header));
+    memcpy(a->pending + a->pending_length + sizeof(header), payload, length);
+    if (extra_length > 0){ memcpy(a->pending + a->pending_length + sizeof(header) + length, extra, extra_length); }
+    a->pending_length += size;
+    return true;
+}
+
+static void connectPeer(agent_link* a){
+    /**
+    * Starts a non-blocking connection to the aggregator and queues the hello frame that opens it
+    */
+
+    a->fd = socket(a->peer.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (a->fd == -1){
+        disconnect(a);
+        return;
+    }
+
+    // A frame is sent once per sample and should leave at once instead of waiting for the previous acknowledgement
+    int nodelay = 1;
+    setsockopt(a->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (connect(a->fd, (struct sockaddr*) &a->peer, a->peer_length) == 0){ markConnected(a); }
+    else if (errno != EINPROGRESS){
+        disconnect(a);
+        return;
+    }
+    a->connections++;
+
+    agent_hello hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = AGENT_MAGIC;
+    hello.version = AGENT_VERSION;
+    hello.sample_size = sizeof(agent_sample);
+    hello.interval = a->interval;
+    if (uname(&hello.host) == -1){ memset(&hello.host, 0, sizeof(hello.host)); }
+    queueFrame(a, AGENT_HELLO, &hello, sizeof(hello), NULL, 0);
+}
+
+static void checkConnected(agent_link* a){
+    // Polls a pending connect without waiting, its outcome is in SO_ERROR once the socket is writable
+    struct pollfd p = { a->fd, POLLOUT, 0 };
+    if (poll(&p, 1, 0) <= 0){ return; }
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(a->fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0){
+        disconnect(a);
+        return;
+    }
+    markConnected(a);
+}
+
+static void flushPending(agent_link* a){
+    /**
+    * Writes as much of the queued frames as the socket accepts right now
+    */
+
+    while (a->sent < a->pending_length){
+        ssize_t written = send(a->fd, a->pending + a->sent, a->pending_length - a->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (written == -1){
+            if (errno == EINTR){ continue; }
+            if (errno != EAGAIN && errno != EWOULDBLOCK){ disconnect(a); }
+            return;
+        }
+        a->sent += written;
+    }
+    a->pending_length = 0;
+    a->sent = 0;
+}
+
+void agentSend(agent_link* a, const sample* s, const user_sessions* users){
+    /**
+    * Streams one sample to the aggregator
+    *
+    * @a: link started with agentStart
+    * @s: sample with the memory and cpu figures
+    * @users: session list, NULL if the agent does not collect users
+    *
+    * Nothing here waits: the connect is non-blocking and polled on the following samples, and frames are written
+    * with MSG_DONTWAIT. What the socket does not take stays queued up to AGENT_BUFFER_SIZE; beyond that, or while
+    * the aggregator is unreachable, samples are dropped and counted, and a lost connection is retried with a
+    * backoff that doubles from 1 s to 30 s.
+    */
+
+    if (a->fd == -1 && monotonicNow() >= a->retry){ connectPeer(a); }
+    if (a->fd != -1 && !a->connected){ checkConnected(a); }
+    if (a->fd == -1){
+        a->dropped++;
+        return;
+    }
+
+    agent_sample frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.timestamp = s->timestamp;
+    frame.interval = s->interval;
+    frame.mem = s->mem;
+    frame.cpu = s->cpu;
+    frame.cpu_use = s->cpu_use;
+    frame.sessions = users != NULL ? users->count : -1;
+    frame.dropped = a->dropped;
+
+    // The session list only travels when it changed, like in the shared memory segment
+    size_t length = 0;
+    bool send_sessions = users != NULL && users->changes != a->session_changes;
+    if (send_sessions && users->text != NULL){
+        length = strlen(users->text);
+        if (length >= AGENT_SESSIONS_SIZE){
+            length = AGENT_SESSIONS_SIZE - 1;
+            while (length > 0 && users->text[length - 1] != '\n'){ length--; }
+        }
+    }
+    frame.sessions_length = send_sessions ? (int32_t) length : -1;
+
+    if (queueFrame(a, AGENT_SAMPLE, &frame, sizeof(frame), send_sessions ? users->text : NULL, length)){
+        if (send_sessions){ a->session_changes = users->changes; }
+    }
+    else { a->dropped++; }
+
+    if (a->connected){ flushPending(a); }
+}
+
+void agentStop(agent_link* a){
+    /**
+    * Sends what the socket still takes without waiting, then closes the connection
+    */
+
+    if (a->fd != -1 && a->connected){ flushPending(a); }
+    if (a->fd != -1){ close(a->fd); }
+    a->fd = -1;
+    free(a->pending);
+    a->pending = NULL;
+}
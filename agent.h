@@ -0,0 +1,79 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "stats_functions.h"
+#include "scheduler.h"
+
+#define AGENT_MAGIC 0x4153534d          // "MSSA"
+#define AGENT_VERSION 1
+#define AGENT_SESSIONS_SIZE (64 * 1024) // longest session list sent, a longer one is cut after its last whole row
+#define AGENT_BUFFER_SIZE (256 * 1024)  // frames an agent keeps while the aggregator is not reading, newer samples are dropped beyond it
+#define AGENT_RETRY_MIN NSEC_PER_SEC    // wait before reconnecting, doubled after every failed attempt
+#define AGENT_RETRY_MAX (30 * NSEC_PER_SEC)
+
+// Types of the frames sent by an agent
+enum agent_frame_type { AGENT_HELLO = 1, AGENT_SAMPLE = 2 };
+
+// Header of every frame, the length prefix lets the aggregator split the stream without parsing it
+typedef struct agent_frame {
+
+    uint32_t length;            // bytes of the frame after this header
+    uint32_t type;
+
+} agent_frame;
+
+// First frame of every connection, identifies the host as footerUsage shows it
+typedef struct agent_hello {
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_size;       // sizeof(agent_sample), both ends must share the layout like a recording
+    uint32_t reserved;
+    int64_t interval;           // sampling interval of the agent in nanoseconds
+    struct utsname host;
+
+} agent_hello;
+
+// One sample, followed by the session list when it changed since the previous frame
+typedef struct agent_sample {
+
+    int64_t timestamp;          // wall clock time in nanoseconds
+    int64_t interval;           // time since the previous sample
+    memory mem;
+    cpu_stats cpu;
+    double cpu_use;
+    int32_t sessions;           // number of sessions, -1 if the agent does not collect users
+    int32_t sessions_length;    // bytes of the session list after the struct, -1 when it did not change
+    int64_t dropped;            // samples the agent could not send since it started
+
+} agent_sample;
+
+// Connection of an agent to its aggregator, driven from the sampling loop without ever blocking it
+typedef struct agent_link {
+
+    const char* address;        // HOST:PORT given with --agent
+    struct sockaddr_storage peer;   // resolved once at start, reconnects do not wait for DNS
+    socklen_t peer_length;
+    long long interval;
+    int fd;                     // -1 while disconnected
+    bool connected;             // the non-blocking connect has completed
+    char* pending;              // frames not yet accepted by the socket
+    size_t pending_length;
+    size_t sent;                // bytes of pending already written
+    long long retry;            // monotonic time of the next connection attempt
+    long long backoff;
+    long int dropped;
+    long int connections;       // connections made, the first one included
+    long int session_changes;   // session list last sent, -1 to send it with the next frame
+
+} agent_link;
+
+bool agentStart(agent_link* a, const char* address, long long interval);
+
+void agentSend(agent_link* a, const sample* s, const user_sessions* users);
+
+void agentStop(agent_link* a);
+
+#endif // AGENT_H
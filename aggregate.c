@@ -0,0 +1,344 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "aggregate.h"
+#include "metrics.h"
+#include "events.h"
+
+static void closeConnection(aggregator* g, event_loop* loop, int k){
+    /**
+    * Drops the connection of a slot, its row stays in the table as down until the agent reconnects
+    */
+
+    aggregate_connection* c = &g->connection[k];
+    eventUnwatch(loop, c->fd);
+    close(c->fd);
+    if (c->host >= 0){
+        g->hosts[c->host].connection = -1;
+        g->hosts[c->host].since = monotonicNow();
+        g->connected--;
+    }
+    free(c->buffer);
+    memset(c, 0, sizeof(aggregate_connection));
+    c->fd = -1;
+    c->host = -1;
+}
+
+static void acceptAgents(aggregator* g, event_loop* loop){
+    /**
+    * Accepts every pending connection, a connection beyond AGGREGATE_MAX_AGENTS is closed right away
+    */
+
+    while (true){
+        int fd = accept(g->listen_fd, NULL, NULL);
+        if (fd == -1){ return; }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        int k = 0;
+        while (k < AGGREGATE_MAX_AGENTS && g->connection[k].fd != -1){ k++; }
+        if (k == AGGREGATE_MAX_AGENTS || !eventWatch(loop, fd, k + 1)){
+            close(fd);
+            g->rejected++;
+            continue;
+        }
+        g->connection[k].fd = fd;
+        g->connection[k].host = -1;
+        g->connection[k].accepted = monotonicNow();
+    }
+}
+
+static int attachHost(aggregator* g, const agent_hello* hello, int k){
+    /**
+    * Finds the row of an agent that said hello, or adds one
+    *
+    * @g: aggregator
+    * @hello: identity of the agent
+    * @k: slot of its connection
+    *
+    * An agent that reconnects gets back the row of its host name that is down, several agents running on the
+    * same host at once, ex. when testing on loopback, get one row each
+    *
+    * Return: the row, -1 if the table is full
+    */
+
+    int same_name = 0, row = -1;
+    for (int h = 0; h < g->host_count && row == -1; h++){
+        if (strcmp(g->hosts[h].identity.nodename, hello->host.nodename) != 0){ continue; }
+        if (g->hosts[h].connection == -1){ row = h; }
+        same_name++;
+    }
+
+    if (row == -1){
+        if (g->host_count == AGGREGATE_MAX_AGENTS){ return -1; }
+        row = g->host_count++;
+        aggregate_host* added = &g->hosts[row];
+        memset(added, 0, sizeof(aggregate_host));
+        if (same_name == 0){ snprintf(added->name, sizeof(added->name), "%s", hello->host.nodename); }
+        else { snprintf(added->name, sizeof(added->name), "%.64s#%d", hello->host.nodename, same_name + 1); }
+    }
+
+    aggregate_host* host = &g->hosts[row];
+    host->identity = hello->host;
+    host->interval = hello->interval > 0 ? hello->interval : NSEC_PER_SEC;
+    host->connection = k;
+    host->since = monotonicNow();
+    host->seen = host->since;
+    host->connections++;
+    g->connected++;
+    return row;
+}
+
+static bool processFrame(aggregator* g, int k, const agent_frame* header, const char* payload){
+    /**
+    * Applies one complete frame of an agent
+    *
+    * Return: false if the frame breaks the protocol, the connection is then dropped
+    */
+
+    aggregate_connection* c = &g->connection[k];
+
+    if (header->type == AGENT_HELLO){
+        if (c->host >= 0 || header->length != sizeof(agent_hello)){ return false; }
+
+        // Frames follow each other at any byte offset of the buffer, the hello is copied out like the samples
+        agent_hello hello;
+        memcpy(&hello, payload, sizeof(hello));
+        if (hello.magic != AGENT_MAGIC || hello.version != AGENT_VERSION || hello.sample_size != sizeof(agent_sample)){ return false; }
+
+        // The identity is written by another program, its strings are not trusted to be terminated
+        hello.host.nodename[sizeof(hello.host.nodename) - 1] = '\0';
+        c->host = attachHost(g, &hello, k);
+        return c->host >= 0;
+    }
+
+    if (header->type != AGENT_SAMPLE || c->host < 0 || header->length < sizeof(agent_sample)){ return false; }
+
+    aggregate_host* host = &g->hosts[c->host];
+    memcpy(&host->last, payload, sizeof(agent_sample));
+    size_t length = host->last.sessions_length > 0 ? (size_t) host->last.sessions_length : 0;
+    if (header->length != sizeof(agent_sample) + length){ return false; }
+
+    if (host->last.sessions_length >= 0){
+        if (length + 1 > host->sessions_capacity){
+            char* larger = realloc(host->sessions, length + 1);
+            if (larger == NULL){ return false; }
+            host->sessions = larger;
+            host->sessions_capacity = length + 1;
+        }
+        memcpy(host->sessions, payload + sizeof(agent_sample), length);
+        host->sessions[length] = '\0';
+    }
+
+    host->sampled = true;
+    host->seen = monotonicNow();
+    host->frames++;
+    return true;
+}
+
+static void readAgent(aggregator* g, event_loop* loop, int k){
+    /**
+    * Reads what an agent sent and applies every frame that is complete
+    *
+    * One read per event: the loop is level triggered, so an agent with more data is reported again
+    * after the others had their turn
+    */
+
+    aggregate_connection* c = &g->connection[k];
+    if (c->capacity - c->length < AGGREGATE_READ_SIZE){
+        char* larger = realloc(c->buffer, c->length + AGGREGATE_READ_SIZE);
+        if (larger == NULL){
+            closeConnection(g, loop, k);
+            return;
+        }
+        c->buffer = larger;
+        c->capacity = c->length + AGGREGATE_READ_SIZE;
+    }
+
+    ssize_t result = read(c->fd, c->buffer + c->length, AGGREGATE_READ_SIZE);
+    if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){ return; }
+    if (result <= 0){
+        closeConnection(g, loop, k);
+        return;
+    }
+    c->length += result;
+
+    size_t offset = 0;
+    while (c->length - offset >= sizeof(agent_frame)){
+        agent_frame header;
+        memcpy(&header, c->buffer + offset, sizeof(header));
+        if (header.length > AGGREGATE_FRAME_MAX){
+            if (c->host < 0){ g->rejected++; }
+            closeConnection(g, loop, k);
+            return;
+        }
+        if (c->length - offset < sizeof(header) + header.length){ break; }
+
+        if (!processFrame(g, k, &header, c->buffer + offset + sizeof(header))){
+            if (c->host < 0){ g->rejected++; }
+            closeConnection(g, loop, k);
+            return;
+        }
+        offset += sizeof(header) + header.length;
+    }
+
+    memmove(c->buffer, c->buffer + offset, c->length - offset);
+    c->length -= offset;
+}
+
+static const aggregate_host* sort_hosts;      // table being sorted, qsort passes no context to its comparison
+
+static int compareRows(const void* a, const void* b){
+    return strcmp(sort_hosts[*(const int*) a].name, sort_hosts[*(const int*) b].name);
+}
+
+static void aggregateOutput(frame* f, const aggregator* g, long long now){
+    /**
+    * Prints one row per host with its state and latest sample, then the totals of the hosts that are up
+    *
+    * @f: frame the output is added to
+    * @g: aggregator
+    * @now: monotonic time of the frame
+    *
+    * A host is stale when it is connected but sent nothing for three of its intervals, and down when disconnected
+    */
+
+    int order[AGGREGATE_MAX_AGENTS];
+    for (int h = 0; h < g->host_count; h++){ order[h] = h; }
+    sort_hosts = g->hosts;
+    qsort(order, g->host_count, sizeof(int), compareRows);
+
+    framePrintf(f, "### Aggregator on %s ###\n", g->address);
+    framePrintf(f, " Agents: %d connected, %d hosts, %ld rejected\n", g->connected, g->host_count, g->rejected);
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, " %-24s %-12s %7s %17s %8s %8s %8s %8s\n", "host", "state", "cpu %", "memory GB", "sessions", "frames", "dropped", "connects");
+
+    int up = 0, sessions = 0;
+    double cpu = 0, used = 0, total = 0;
+    for (int n = 0; n < g->host_count; n++){
+        const aggregate_host* host = &g->hosts[order[n]];
+        char state[32];
+        if (host->connection == -1){ snprintf(state, sizeof(state), "down %llds", (now - host->since) / NSEC_PER_SEC); }
+        else if (now - host->seen > 3 * host->interval){ snprintf(state, sizeof(state), "stale %llds", (now - host->seen) / NSEC_PER_SEC); }
+        else { snprintf(state, sizeof(state), "up"); }
+
+        if (!host->sampled){
+            framePrintf(f, " %-24s %-12s %7s %17s %8s %8ld %8s %8ld\n", host->name, state, "-", "-", "-", host->frames, "-", host->connections);
+            continue;
+        }
+
+        const agent_sample* s = &host->last;
+        char memory_text[32], sessions_text[16];
+        snprintf(memory_text, sizeof(memory_text), "%.2f / %.2f", s->mem.used_memory, s->mem.total_memory);
+        if (s->sessions >= 0){ snprintf(sessions_text, sizeof(sessions_text), "%d", s->sessions); }
+        else { snprintf(sessions_text, sizeof(sessions_text), "-"); }
+        framePrintf(f, " %-24s %-12s %7.2f %17s %8s %8ld %8lld %8ld\n", host->name, state, s->cpu_use, memory_text, sessions_text,
+                    host->frames, (long long) s->dropped, host->connections);
+
+        if (host->connection != -1){
+            up++;
+            cpu += s->cpu_use;
+            used += s->mem.used_memory;
+            total += s->mem.total_memory;
+            if (s->sessions > 0){ sessions += s->sessions; }
+        }
+    }
+
+    framePrintf(f, "--------------------------------------------\n");
+    if (up > 0){
+        framePrintf(f, " %d hosts up: average cpu use %.2f%%, memory %.2f GB used of %.2f GB, %d sessions\n", up, cpu / up, used, total, sessions);
+    }
+    else { framePrintf(f, " No host is up\n"); }
+}
+
+void aggregate(const options* opts){
+    /**
+    * Receives the samples streamed by --agent monitors and shows them as one table
+    *
+    * @opts: command line options, with
+    *   aggregate: PORT or ADDR:PORT to listen on
+    *   samples: number of frames shown before exiting
+    *   interval: time between two frames
+    *   sequential: append the frames instead of updating the screen in place
+    *
+    * The listening socket and every agent connection are watched by the same epoll loop as the signals and the
+    * frame timer, all non-blocking, so hundreds of agents are served by this one thread. The aggregator never
+    * writes to its agents: one that cannot keep up only fills its own socket buffer, and the agent drops samples.
+    */
+
+    event_loop loop;
+    if (!eventLoopInit(&loop, false)){ exit(EXIT_FAILURE); }
+
+    static aggregator g;
+    memset(&g, 0, sizeof(g));
+    snprintf(g.address, sizeof(g.address), "%s%s", strchr(opts->aggregate, ':') == NULL ? ":" : "", opts->aggregate);
+    for (int k = 0; k < AGGREGATE_MAX_AGENTS; k++){
+        g.connection[k].fd = -1;
+        g.connection[k].host = -1;
+    }
+    g.hosts = calloc(AGGREGATE_MAX_AGENTS, sizeof(aggregate_host));
+    if (g.hosts == NULL){
+        fprintf(stderr, "Error: failed to allocate the host table\n");
+        exit(EXIT_FAILURE);
+    }
+
+    g.listen_fd = listenTcp(g.address, AGGREGATE_MAX_AGENTS);
+    if (g.listen_fd == -1 || !eventWatch(&loop, g.listen_fd, 0)){ exit(EXIT_FAILURE); }
+
+    renderer screen;
+    rendererInit(&screen, opts->sequential);
+    scheduler schedule;
+    schedulerStart(&schedule, opts->interval);
+
+    bool quit = false;
+    for (int i = 0; i < opts->samples && !quit; i++){
+        if (i > 0){ schedulerAdvance(&schedule); }
+
+        // Serve the agents until the next frame is due
+        bool due = false;
+        while (!due && !quit){
+            event e = eventNext(&loop, schedule.next);
+            switch (e.type){
+                case EVENT_TIMEOUT:
+                    due = true;
+                    break;
+                case EVENT_SIGNAL:
+                    if (e.signal == SIGINT || e.signal == SIGTERM){ quit = true; }
+                    if (e.signal == SIGWINCH){ rendererResize(&screen); }
+                    break;
+                case EVENT_CHANNEL:
+                    if (e.tag == 0){ acceptAgents(&g, &loop); }
+                    else { readAgent(&g, &loop, e.tag - 1); }
+                    break;
+                case EVENT_INPUT:
+                    break;
+                case EVENT_ERROR:
+                    quit = true;
+                    break;
+            }
+        }
+
+        // A connection that never said hello only holds a slot
+        long long now = monotonicNow();
+        for (int k = 0; k < AGGREGATE_MAX_AGENTS; k++){
+            aggregate_connection* c = &g.connection[k];
+            if (c->fd != -1 && c->host < 0 && now - c->accepted > AGGREGATE_HELLO_TIMEOUT){
+                closeConnection(&g, &loop, k);
+                g.rejected++;
+            }
+        }
+
+        frame* f = frameBegin(&screen);
+        if (opts->sequential){ framePrintf(f, ">>> iteration %d\n", i); }
+        aggregateOutput(f, &g, now);
+        frameFlush(&screen);
+    }
+
+    for (int k = 0; k < AGGREGATE_MAX_AGENTS; k++){
+        if (g.connection[k].fd != -1){ closeConnection(&g, &loop, k); }
+    }
+    for (int h = 0; h < g.host_count; h++){ free(g.hosts[h].sessions); }
+    free(g.hosts);
+    close(g.listen_fd);
+    rendererFree(&screen);
+    eventLoopClose(&loop);
+}
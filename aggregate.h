@@ -0,0 +1,57 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "agent.h"
+#include "options.h"
+
+#define AGGREGATE_MAX_AGENTS 1024
+#define AGGREGATE_FRAME_MAX (sizeof(agent_frame) + sizeof(agent_sample) + AGENT_SESSIONS_SIZE)
+#define AGGREGATE_READ_SIZE 65536           // bytes read from an agent per event, so a busy agent does not starve the others
+#define AGGREGATE_HELLO_TIMEOUT (10 * NSEC_PER_SEC)
+
+// Connection of an agent, a row of the table is only attached to it once its hello arrived
+typedef struct aggregate_connection {
+
+    int fd;                     // -1 for a free slot
+    int host;                   // row of the table, -1 before the hello
+    char* buffer;               // bytes of the frames not processed yet, the last one may be incomplete
+    size_t length;
+    size_t capacity;
+    long long accepted;         // monotonic time of the accept
+
+} aggregate_connection;
+
+// Row of the table, kept when its agent disconnects so a reconnecting agent gets it back
+typedef struct aggregate_host {
+
+    char name[80];              // nodename, with "#N" for another agent of the same name connected at the same time
+    struct utsname identity;
+    int connection;             // slot of the connection, -1 while the agent is disconnected
+    long long interval;
+    long long seen;             // monotonic time of the last frame
+    long long since;            // monotonic time of the last connect or disconnect
+    bool sampled;
+    agent_sample last;
+    char* sessions;             // latest session list of the host
+    size_t sessions_capacity;
+    long int frames;
+    long int connections;
+
+} aggregate_host;
+
+// State of an --aggregate run
+typedef struct aggregator {
+
+    char address[256];
+    int listen_fd;
+    aggregate_connection connection[AGGREGATE_MAX_AGENTS];
+    aggregate_host* hosts;      // AGGREGATE_MAX_AGENTS rows allocated at start
+    int host_count;
+    int connected;
+    long int rejected;          // connections refused because the table was full or the hello did not match
+
+} aggregator;
+
+void aggregate(const options* opts);
+
+#endif // AGGREGATE_H
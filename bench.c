@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
+#include "procfs.h"
+#include "collectors.h"
+#include "history.h"
+#include "fixtures.h"
+
+#define DEFAULT_ITERATIONS 20000
+#define DEFAULT_SCALE_SAMPLES 200
+
+// Sizes of the synthetic hosts, from a single cpu laptop to a large shared server
+static const struct { int cpus; int sessions; } scales[] = { { 1, 10 }, { 16, 100 }, { 128, 1000 }, { 1024, 10000 } };
+
+// Stages timed on every fixture
+enum bench_stage { BENCH_MEMORY, BENCH_CPU, BENCH_CORES, BENCH_USERS, BENCH_USERS_CHANGED, BENCH_RENDER, BENCH_FLUSH, BENCH_STAGES };
+
+static const char* bench_stage_names[BENCH_STAGES] = { "memoryStats", "cpuStats", "coreStats", "userOutput", "userOutput changed",
+                                                       "render frame", "flush full frame" };
+
+static double now(){
+    /**
+    * Return: monotonic time in nanoseconds
+    */
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long int stdioSample(){
+    /**
+    * Per-sample work of the original cpu collector: sysinfo, then fopen/fscanf/fclose of /proc/stat
+    *
+    * Return: a value derived from the sample so the work cannot be optimized away
+    */
+
+    struct sysinfo info;
+    sysinfo(&info);
+
+    long int v[7] = {0};
+    FILE *fp = fopen("/proc/stat", "r");
+    if (fp == NULL){ return 0; }
+    if (fscanf(fp, "cpu %ld %ld %ld %ld %ld %ld %ld", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7){ v[0] = 0; }
+    fclose(fp);
+
+    return v[0] + v[3];
+}
+
+static long int procfsSample(proc_file* stat_file){
+    /**
+    * Per-sample work of the current cpu collector: pread of the held open /proc/stat and the integer scanner
+    *
+    * Return: a value derived from the sample so the work cannot be optimized away
+    */
+
+    if (procRead(stat_file) == -1){ return 0; }
+
+    long int v[7] = {0};
+    const char* cursor = stat_file->buffer + 4;
+    const char* end = stat_file->buffer + stat_file->length;
+    for (int f = 0; f < 7 && procNextInteger(&cursor, end, &v[f]); f++){ }
+
+    return v[0] + v[3];
+}
+
+static int compareDouble(const void* a, const void* b){
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static void reportStage(int cpus, int sessions, enum bench_stage stage, double* latency, int samples){
+    /**
+    * Prints the throughput and the 99th percentile latency of one stage
+    *
+    * @latency: per-sample latencies in nanoseconds, sorted in place
+    */
+
+    double total = 0;
+    for (int k = 0; k < samples; k++){ total += latency[k]; }
+    qsort(latency, samples, sizeof(double), compareDouble);
+    int p99 = (int)(0.99 * (samples - 1) + 0.5);
+
+    printf(" %5d %8d  %-20s %12.0f %10.1f\n", cpus, sessions, bench_stage_names[stage], samples / (total / 1e9), latency[p99] / 1e3);
+}
+
+static double collectorSample(collector* c, void* data, size_t size){
+    /**
+    * Takes one sample of a fixed size collector
+    *
+    * Return: latency from the request until the data has been read, in nanoseconds
+    */
+
+    double start = now();
+    requestSample(c);
+    if (collectorRead(c, data, size) != (ssize_t) size){ perror("Error reading from collector"); }
+    finishSample(c);
+    return now() - start;
+}
+
+static void benchScale(const char* dir, int cpus, int sessions, int samples){
+    /**
+    * Times every collector and the renderer against one fixture directory
+    *
+    * @dir: directory written by writeFixtures
+    * @cpus, sessions: size of the fixture, for the report
+    * @samples: number of samples per stage
+    *
+    * Runs in a child of the benchmark, the collectors keep their files open in static state
+    * so every fixture needs a fresh process. Collectors run as threads so the latency is the parse and the pipe, not a fork.
+    */
+
+    char utmp[4096];
+    snprintf(utmp, sizeof(utmp), "%s/utmp", dir);
+    proc_root = dir;
+    utmp_path = utmp;
+
+    collector memory_collector, cpu_collector, core_collector, user_collector;
+    startCollector(&memory_collector, MODE_THREAD, memoryStats);
+    startCollector(&cpu_collector, MODE_THREAD, cpuStats);
+    startCollector(&core_collector, MODE_THREAD, coreStats);
+    startCollector(&user_collector, MODE_THREAD, userOutput);
+
+    double* latency[BENCH_STAGES];
+    for (int k = 0; k < BENCH_STAGES; k++){
+        latency[k] = malloc(samples * sizeof(double));
+        if (latency[k] == NULL){ perror("Error allocating latencies"); exit(1); }
+    }
+
+    history h;
+    if (!historyInit(&h, DEFAULT_HISTORY)){ exit(1); }
+    static cpu_cores cores;
+    static core_previous previous_cores;
+    static double core_use[MAX_CPUS];
+    user_sessions users;
+    memset(&users, 0, sizeof(users));
+    memset(&previous_cores, 0, sizeof(previous_cores));
+    long int cpu_previous = 0, idle_previous = 0;
+
+    int utmp_fd = open(utmp, O_RDONLY | O_CLOEXEC);
+    if (utmp_fd == -1){ perror("Error opening the utmp fixture"); exit(1); }
+
+    // Frames go to /dev/null, the report keeps the original standard output
+    fflush(stdout);
+    int report_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (report_fd == -1 || null_fd == -1 || dup2(null_fd, STDOUT_FILENO) == -1){ perror("Error redirecting the frames"); exit(1); }
+    renderer screen;
+    rendererInit(&screen, false);
+
+    for (int i = 0; i < samples; i++){
+        sample* current = historyAppend(&h);
+        latency[BENCH_MEMORY][i] = collectorSample(&memory_collector, &current->mem, sizeof(current->mem));
+        latency[BENCH_CPU][i] = collectorSample(&cpu_collector, &current->cpu, sizeof(current->cpu));
+        current->cpu_use = cpuUsage(current->cpu, &cpu_previous, &idle_previous);
+
+        double start = now();
+        requestSample(&core_collector);
+        if (readCores(&core_collector, &cores) == -1){ perror("Error reading from collector"); }
+        finishSample(&core_collector);
+        latency[BENCH_CORES][i] = now() - start;
+        coreDeltas(&cores, &previous_cores, core_use);
+
+        // The unchanged file costs one inotify read, touching it forces a parse and a diff of every session
+        start = now();
+        requestSample(&user_collector);
+        if (readUsers(&user_collector, &users) == -1){ perror("Error reading from collector"); }
+        finishSample(&user_collector);
+        latency[BENCH_USERS][i] = now() - start;
+
+        if (futimens(utmp_fd, NULL) == -1){ perror("Error touching the utmp fixture"); }
+        start = now();
+        requestSample(&user_collector);
+        if (readUsers(&user_collector, &users) == -1){ perror("Error reading from collector"); }
+        finishSample(&user_collector);
+        latency[BENCH_USERS_CHANGED][i] = now() - start;
+
+        // The same sections as the default screen with --per-cpu
+        start = now();
+        frame* f = frameBegin(&screen);
+        headerUsage(f, samples, 1);
+        systemOutput(f, &h, false, false, false);
+        framePrintf(f, "--------------------------------------------\n");
+        framePrintf(f, "### Sessions/users ###\n");
+        if (users.text != NULL){ framePrintf(f, "%s", users.text); }
+        CPUOutput(f, &h, false, false);
+        coreOutput(f, false, &cores, core_use);
+        latency[BENCH_RENDER][i] = now() - start;
+
+        // Identical frames would send nothing, the whole screen is repainted instead
+        rendererInvalidate(&screen);
+        start = now();
+        frameFlush(&screen);
+        latency[BENCH_FLUSH][i] = now() - start;
+    }
+
+    if (dup2(report_fd, STDOUT_FILENO) == -1){ perror("Error restoring standard output"); exit(1); }
+    for (int k = 0; k < BENCH_STAGES; k++){
+        reportStage(cpus, sessions, k, latency[k], samples);
+        free(latency[k]);
+    }
+    fflush(stdout);
+
+    stopCollector(&memory_collector);
+    stopCollector(&cpu_collector);
+    stopCollector(&core_collector);
+    stopCollector(&user_collector);
+    rendererFree(&screen);
+    historyFree(&h);
+    free(users.text);
+    free(users.events);
+    close(utmp_fd);
+    close(null_fd);
+    close(report_fd);
+}
+
+static void removeFixtures(const char* dir){
+    const char* names[] = { "stat", "meminfo", "utmp" };
+    char path[4096];
+    for (int k = 0; k < 3; k++){
+        snprintf(path, sizeof(path), "%s/%s", dir, names[k]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+static bool benchScales(int samples){
+    /**
+    * Runs benchScale on a fixture of every size in scales
+    *
+    * Return: false if a fixture could not be written or a run failed
+    */
+
+    printf("\nPer-sample latency of the collectors and the renderer on synthetic fixtures, %d samples each\n", samples);
+    printf(" %5s %8s  %-20s %12s %10s\n", "cpus", "sessions", "stage", "samples/s", "p99 us");
+    fflush(stdout);
+
+    for (size_t k = 0; k < sizeof(scales) / sizeof(scales[0]); k++){
+        char dir[] = "/tmp/mySystemStatsBench.XXXXXX";
+        if (mkdtemp(dir) == NULL){
+            perror("Error creating the fixture directory");
+            return false;
+        }
+        if (!writeFixtures(dir, scales[k].cpus, scales[k].sessions)){
+            removeFixtures(dir);
+            return false;
+        }
+
+        pid_t pid = fork();
+        if (pid == -1){
+            perror("Error forking the benchmark");
+            removeFixtures(dir);
+            return false;
+        }
+        if (pid == 0){
+            benchScale(dir, scales[k].cpus, scales[k].sessions, samples);
+            exit(0);
+        }
+
+        int status;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR){ }
+        removeFixtures(dir);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){ return false; }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]){
+    /**
+    * Benchmarks the per-sample cost of reading /proc/stat, then of every collector and the renderer on fixtures of growing size
+    *
+    * @argc: Number of command-line arguments
+    * @argv: optional number of iterations of the /proc/stat comparison, --samples=N samples per fixture,
+    *        or --generate=DIR [--cpus=N] [--sessions=N] to only write a fixture directory for mySystemStats --proc-root=DIR --utmp=DIR/utmp
+    *
+    * Return: 0 on success, non-zero on error
+    */
+
+    int iterations = DEFAULT_ITERATIONS, samples = DEFAULT_SCALE_SAMPLES;
+    int cpus = 4, sessions = 10;
+    const char* generate = NULL;
+
+    for (int i = 1; i < argc; i++){
+        if (strncmp(argv[i], "--generate=", 11) == 0){ generate = argv[i] + 11; }
+        else if (strncmp(argv[i], "--cpus=", 7) == 0){ cpus = atoi(argv[i] + 7); }
+        else if (strncmp(argv[i], "--sessions=", 11) == 0){ sessions = atoi(argv[i] + 11); }
+        else if (strncmp(argv[i], "--samples=", 10) == 0){ samples = atoi(argv[i] + 10); }
+        else { iterations = atoi(argv[i]); }
+    }
+    if (iterations <= 0){ iterations = DEFAULT_ITERATIONS; }
+    if (samples <= 0){ samples = DEFAULT_SCALE_SAMPLES; }
+
+    if (generate != NULL){ return writeFixtures(generate, cpus, sessions) ? 0 : 1; }
+
+    proc_file stat_file = PROC_FILE_INIT;
+    if (!procOpen(&stat_file, "/proc/stat")){
+        perror("Error opening /proc/stat");
+        return 1;
+    }
+
+    long int checksum = 0;
+
+    double start = now();
+    for (int i = 0; i < iterations; i++){ checksum += stdioSample(); }
+    double stdio_ns = (now() - start) / iterations;
+
+    start = now();
+    for (int i = 0; i < iterations; i++){ checksum += procfsSample(&stat_file); }
+    double procfs_ns = (now() - start) / iterations;
+
+    procClose(&stat_file);
+
+    printf("/proc/stat per-sample cost over %d iterations\n", iterations);
+    printf(" sysinfo + fopen/fscanf/fclose: %10.0f ns\n", stdio_ns);
+    printf(" held open pread + scanner:     %10.0f ns\n", procfs_ns);
+    printf(" speedup:                       %10.2fx\n", stdio_ns / procfs_ns);
+
+    if (!benchScales(samples)){ return 1; }
+
+    return checksum == 0;
+}
@@ -0,0 +1,327 @@
+#include <sys/stat.h>
+#include "cgroup.h"
+#include "collectors.h"
+#include "scheduler.h"
+
+char cgroup_dir[CGROUP_PATH_SIZE];
+
+static bool isCgroup(const char* dir){
+    // Every cgroup v2 directory, the root included, has a cgroup.controllers file
+    char path[CGROUP_PATH_SIZE + 32];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/cgroup.controllers", dir);
+    return stat(path, &st) == 0;
+}
+
+static size_t lineField(const char* line, const char* line_end, size_t field, const char** start){
+    // Finds a space separated field of a line, returns its length, 0 if the line is shorter
+    const char* cursor = line;
+    for (size_t k = 0; k < field && cursor < line_end; k++){
+        while (cursor < line_end && *cursor != ' '){ cursor++; }
+        if (cursor < line_end){ cursor++; }
+    }
+    const char* stop = cursor;
+    while (stop < line_end && *stop != ' ' && *stop != '\n'){ stop++; }
+    *start = cursor;
+    return stop - cursor;
+}
+
+static bool findField(const char* path, size_t match_field, const char* prefix, size_t field, char* value, size_t size){
+    /**
+    * Copies a field of the first line of a /proc file whose match_field starts with prefix
+    *
+    * @path: path of the file, mapped under --proc-root
+    * @match_field, prefix: the line to look for, fields are separated by spaces and the first one is 0
+    * @field: field to copy
+    * @value, size: receives the field
+    *
+    * Only used once when --cgroup starts, so the file is not held open
+    *
+    * Return: true if the line and the field were found
+    */
+
+    proc_file file = PROC_FILE_INIT;
+    bool found = false;
+    if (procOpen(&file, path) && procRead(&file) != -1){
+        const char* end = file.buffer + file.length;
+        for (const char* line = file.buffer; line < end && !found; line = procNextLine(line, end)){
+            const char* line_end = procNextLine(line, end);
+            const char* start;
+            size_t length = lineField(line, line_end, match_field, &start);
+            if (length < strlen(prefix) || strncmp(start, prefix, strlen(prefix)) != 0){ continue; }
+
+            length = lineField(line, line_end, field, &start);
+            if (length > 0 && length < size){
+                memcpy(value, start, length);
+                value[length] = '\0';
+                found = true;
+            }
+        }
+    }
+    procClose(&file);
+    return found;
+}
+
+bool cgroupResolve(const char* requested){
+    /**
+    * Finds the cgroup v2 directory shown by --cgroup and stores it in cgroup_dir
+    *
+    * @requested: directory of a cgroup, or a cgroup path such as "/system.slice/sshd.service" relative to the
+    *             cgroup v2 mount, NULL for the cgroup of this process as listed in /proc/self/cgroup
+    *
+    * The cgroup v2 hierarchy is found in /proc/self/mounts, it is /sys/fs/cgroup on most systems
+    * and /sys/fs/cgroup/unified on hybrid ones
+    *
+    * Return: false if no cgroup v2 directory was found (a message has been printed)
+    */
+
+    if (requested != NULL && isCgroup(requested)){
+        snprintf(cgroup_dir, sizeof(cgroup_dir), "%s", requested);
+        return true;
+    }
+
+    // Each line of /proc/self/mounts is "device mountpoint type options ..."
+    char mount[CGROUP_PATH_SIZE];
+    if (!findField("/proc/self/mounts", 2, "cgroup2", 1, mount, sizeof(mount))){
+        fprintf(stderr, "Error: no cgroup v2 hierarchy is mounted, --cgroup needs a cgroup v2 directory\n");
+        return false;
+    }
+
+    // The v2 entry of /proc/self/cgroup is "0::/path"
+    char own[CGROUP_PATH_SIZE];
+    if (requested == NULL){
+        if (!findField("/proc/self/cgroup", 0, "0::", 0, own, sizeof(own))){
+            fprintf(stderr, "Error: failed to find the cgroup v2 of this process in /proc/self/cgroup\n");
+            return false;
+        }
+        requested = own + 3;
+    }
+
+    if ((size_t) snprintf(cgroup_dir, sizeof(cgroup_dir), "%s%s%s", mount, requested[0] == '/' ? "" : "/", requested) >= sizeof(cgroup_dir)){
+        fprintf(stderr, "Error: the cgroup path %s is too long\n", requested);
+        return false;
+    }
+    size_t length = strlen(cgroup_dir);
+    while (length > 1 && cgroup_dir[length - 1] == '/'){ cgroup_dir[--length] = '\0'; }
+
+    if (!isCgroup(cgroup_dir)){
+        fprintf(stderr, "Error: %s is not a cgroup v2 directory\n", cgroup_dir);
+        return false;
+    }
+    return true;
+}
+
+static bool readCgroupFile(proc_file* file, const char* name){
+    /**
+    * Reads a file of the cgroup directory, opened on first use and then held open like the /proc files
+    *
+    * @file: proc_file kept by the collector between samples
+    * @name: name of the file in cgroup_dir
+    *
+    * Files of a controller that is not enabled for the cgroup, and the limits of the root cgroup, do not exist.
+    * Unlike a /proc file this is not an error, the figure is only left out.
+    *
+    * Return: true if the file was read
+    */
+
+    if (file->fd < 0){
+        char path[CGROUP_PATH_SIZE + 64];
+        snprintf(path, sizeof(path), "%s/%s", cgroup_dir, name);
+        if (!procOpen(file, path)){ return false; }
+    }
+    return procRead(file) > 0;
+}
+
+static long int readLimit(const proc_file* file, long int* second){
+    /**
+    * Parses a file of the form "value" or "value second", ex. memory.current, memory.max or cpu.max
+    *
+    * @file: proc_file that was read
+    * @second: receives the second number, may be NULL
+    *
+    * Return: the first number, -1 for "max"
+    */
+
+    const char* cursor = file->buffer;
+    const char* end = file->buffer + file->length;
+    long int value = -1;
+    if (!procNextInteger(&cursor, end, &value)){
+        while (cursor < end && *cursor != ' ' && *cursor != '\n'){ cursor++; }
+    }
+    if (second != NULL){ procNextInteger(&cursor, end, second); }
+    return value;
+}
+
+static void readKeys(const proc_file* file, const char* const keys[], long int* const values[], int count){
+    /**
+    * Parses the lines "key value" of a flat keyed file such as memory.stat or cpu.stat
+    *
+    * @file: proc_file that was read
+    * @keys, values: names of the wanted keys and where their values go, a key that is not in the file keeps its value
+    * @count: number of keys
+    */
+
+    int found = 0;
+    const char* end = file->buffer + file->length;
+    for (const char* line = file->buffer; line < end && found < count; line = procNextLine(line, end)){
+        const char* space = memchr(line, ' ', procNextLine(line, end) - line);
+        if (space == NULL){ continue; }
+
+        for (int k = 0; k < count; k++){
+            if ((size_t)(space - line) != strlen(keys[k]) || memcmp(line, keys[k], space - line) != 0){ continue; }
+            const char* cursor = space;
+            if (procNextInteger(&cursor, end, values[k])){ found++; }
+            break;
+        }
+    }
+}
+
+static int countCpus(const proc_file* file){
+    /**
+    * Return: number of cpus in a cpu list such as "0-3,8,10-11", 0 if it is empty
+    */
+
+    const char* cursor = file->buffer;
+    const char* end = file->buffer + file->length;
+    int cpus = 0;
+    long int first, last;
+    while (procNextInteger(&cursor, end, &first)){
+        last = first;
+        if (cursor < end && *cursor == '-'){
+            cursor++;
+            procNextInteger(&cursor, end, &last);
+        }
+        cpus += last - first + 1;
+        if (cursor < end && *cursor == ','){ cursor++; }
+    }
+    return cpus;
+}
+
+void cgroupStats(int pipefd[2]){
+    /**
+    * Reads the memory and cpu figures of the cgroup and writes them to the pipe
+    *
+    * @pipefd: pipe the cgroup_stats struct is written to
+    *
+    * memory.current, memory.max, memory.stat, cpu.stat, cpu.max and cpuset.cpus.effective are held open and re-read with one pread each
+    */
+
+    cgroup_stats info;
+    static proc_file current_file = PROC_FILE_INIT, max_file = PROC_FILE_INIT, memory_stat_file = PROC_FILE_INIT;
+    static proc_file cpu_stat_file = PROC_FILE_INIT, cpu_max_file = PROC_FILE_INIT, cpus_file = PROC_FILE_INIT;
+
+    info.memory_current = readCgroupFile(&current_file, "memory.current") ? readLimit(&current_file, NULL) : -1;
+    info.memory_max = readCgroupFile(&max_file, "memory.max") ? readLimit(&max_file, NULL) : -1;
+
+    info.anon = -1; info.file = -1; info.inactive_file = -1;
+    if (readCgroupFile(&memory_stat_file, "memory.stat")){
+        static const char* const memory_keys[] = { "anon", "file", "inactive_file" };
+        long int* const memory_values[] = { &info.anon, &info.file, &info.inactive_file };
+        readKeys(&memory_stat_file, memory_keys, memory_values, 3);
+    }
+
+    // cpu.stat always has the usage, the throttling counters only once the cpu controller is enabled
+    info.usage_usec = -1; info.user_usec = -1; info.system_usec = -1;
+    info.nr_periods = -1; info.nr_throttled = -1; info.throttled_usec = -1;
+    if (readCgroupFile(&cpu_stat_file, "cpu.stat")){
+        static const char* const cpu_keys[] = { "usage_usec", "user_usec", "system_usec", "nr_periods", "nr_throttled", "throttled_usec" };
+        long int* const cpu_values[] = { &info.usage_usec, &info.user_usec, &info.system_usec, &info.nr_periods, &info.nr_throttled, &info.throttled_usec };
+        readKeys(&cpu_stat_file, cpu_keys, cpu_values, 6);
+    }
+
+    // cpu.max is "quota period" with "max" as the quota when there is none
+    info.quota_usec = -1; info.period_usec = -1;
+    if (readCgroupFile(&cpu_max_file, "cpu.max")){ info.quota_usec = readLimit(&cpu_max_file, &info.period_usec); }
+
+    info.cpus = readCgroupFile(&cpus_file, "cpuset.cpus.effective") ? countCpus(&cpus_file) : 0;
+    if (info.cpus <= 0){ info.cpus = sysconf(_SC_NPROCESSORS_ONLN); }
+
+    info.timestamp = monotonicNow();
+
+    if (info.memory_current == -1 && info.usage_usec == -1){
+        fprintf(stderr, "Error: failed to read memory.current and cpu.stat in %s\n", cgroup_dir);
+        terminateCollector();
+        return;
+    }
+
+    if (collectorWrite(pipefd, &info, sizeof(info)) == -1) {
+        perror("Error writing to pipe");
+        terminateCollector();
+    }
+}
+
+static double counterRate(long int current, long int previous, double elapsed){
+    // Counters that are missing, or that went back because the cgroup was recreated, give no rate
+    return current >= 0 && previous >= 0 && current >= previous && elapsed > 0 ? (current - previous) / elapsed : 0;
+}
+
+void cgroupDeltas(const cgroup_stats* current, cgroup_stats* previous, cgroup_rates* rates){
+    /**
+    * Computes the figures of the cgroup since the previous sample
+    *
+    * @current: counters of this sample
+    * @previous: counters of the previous sample, replaced by the current ones for the next iteration,
+    *            its timestamp is 0 before the first sample
+    * @rates: receives the figures, the cpu rates are 0 on the first sample
+    *
+    * Usage is measured against the quota of cpu.max, or against the cpus of the cpuset when there is no quota,
+    * so a container limited to 2 cpus on a 64 cpu host is at 100% when it uses 2 of them
+    */
+
+    double elapsed = previous->timestamp > 0 ? (double)(current->timestamp - previous->timestamp) / NSEC_PER_SEC : 0;
+
+    rates->cpu_used = counterRate(current->usage_usec, previous->usage_usec, elapsed) / 1e6;
+    rates->cpu_limit = current->quota_usec > 0 && current->period_usec > 0 ? (double) current->quota_usec / current->period_usec : current->cpus;
+    rates->cpu_use = rates->cpu_limit > 0 ? 100 * rates->cpu_used / rates->cpu_limit : 0;
+
+    rates->throttled_ms = counterRate(current->throttled_usec, previous->throttled_usec, elapsed) / 1000;
+    double periods = counterRate(current->nr_periods, previous->nr_periods, elapsed);
+    rates->throttled_periods = periods > 0 ? 100 * counterRate(current->nr_throttled, previous->nr_throttled, elapsed) / periods : 0;
+
+    rates->memory_use = current->memory_max > 0 && current->memory_current >= 0 ? 100.0 * current->memory_current / current->memory_max : 0;
+    rates->working_set = current->memory_current;
+    if (current->inactive_file > 0){ rates->working_set -= current->inactive_file; }
+    if (rates->working_set < 0){ rates->working_set = 0; }
+
+    *previous = *current;
+}
+
+void cgroupOutput(frame* f, bool graphics, const cgroup_stats* cgroup, const cgroup_rates* rates){
+    /**
+    * Prints the memory and cpu use of the cgroup against its limits, and how much it was throttled
+    *
+    * @f: frame the output is added to
+    * @graphics: boolean value indicating whether graphics option has been selected
+    * @cgroup: counters of the current sample
+    * @rates: figures computed by cgroupDeltas
+    */
+
+    const double bytes_per_gb = 1024.0 * 1024 * 1024;
+    char bar[64];
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Cgroup %s ###\n", cgroup_dir);
+
+    if (cgroup->memory_current >= 0){
+        frameBar(bar, sizeof(bar), graphics && cgroup->memory_max > 0, rates->memory_use);
+        if (cgroup->memory_max > 0){
+            framePrintf(f, " Memory: %.2f GB of %.2f GB limit (%.2f%%)%s\n", cgroup->memory_current / bytes_per_gb, cgroup->memory_max / bytes_per_gb,
+                        rates->memory_use, bar);
+        }
+        else { framePrintf(f, " Memory: %.2f GB, no limit\n", cgroup->memory_current / bytes_per_gb); }
+        if (cgroup->anon >= 0){
+            framePrintf(f, "   working set %.2f GB, anon %.2f GB, file %.2f GB\n", rates->working_set / bytes_per_gb,
+                        cgroup->anon / bytes_per_gb, cgroup->file / bytes_per_gb);
+        }
+    }
+
+    if (cgroup->usage_usec >= 0){
+        frameBar(bar, sizeof(bar), graphics, rates->cpu_use);
+        framePrintf(f, " CPU: %.2f of %.2f cpus %s (%.2f%%)%s\n", rates->cpu_used, rates->cpu_limit,
+                    cgroup->quota_usec > 0 ? "quota" : "available", rates->cpu_use, bar);
+    }
+
+    if (cgroup->nr_periods >= 0){
+        framePrintf(f, " Throttled: %.1f ms/s, in %.2f%% of the periods\n", rates->throttled_ms, rates->throttled_periods);
+    }
+}
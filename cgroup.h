@@ -0,0 +1,53 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include "stats_functions.h"
+
+#define CGROUP_PATH_SIZE 4096
+
+// Counters of the cgroup at one sample, -1 for a figure whose file the kernel does not provide for that cgroup
+typedef struct cgroup_stats {
+
+    long long timestamp;        // monotonic time of the read in nanoseconds
+    long int memory_current;    // memory.current, bytes
+    long int memory_max;        // memory.max, bytes, -1 when unlimited
+    long int anon;              // memory.stat, bytes
+    long int file;
+    long int inactive_file;
+    long int usage_usec;        // cpu.stat
+    long int user_usec;
+    long int system_usec;
+    long int nr_periods;
+    long int nr_throttled;
+    long int throttled_usec;
+    long int quota_usec;        // cpu.max, -1 when unlimited
+    long int period_usec;
+    int cpus;                   // cpus the cgroup may run on, from cpuset.cpus.effective
+
+} cgroup_stats;
+
+// Figures of the cgroup between two samples, measured against its limits
+typedef struct cgroup_rates {
+
+    double cpu_used;            // cpus worth of time used
+    double cpu_limit;           // quota in cpus, or the cpus the cgroup may run on when it has none
+    double cpu_use;             // percent of cpu_limit
+    double memory_use;          // percent of memory.max, 0 when unlimited
+    double working_set;         // bytes, memory.current minus the inactive page cache
+    double throttled_ms;        // time the cgroup was throttled per second, in ms summed over its cpus
+    double throttled_periods;   // percent of the enforcement periods in which it was throttled
+
+} cgroup_rates;
+
+// Directory of the cgroup shown by --cgroup, set by cgroupResolve before any collector starts
+extern char cgroup_dir[CGROUP_PATH_SIZE];
+
+bool cgroupResolve(const char* requested);
+
+void cgroupStats(int pipefd[2]);
+
+void cgroupDeltas(const cgroup_stats* current, cgroup_stats* previous, cgroup_rates* rates);
+
+void cgroupOutput(frame* f, bool graphics, const cgroup_stats* cgroup, const cgroup_rates* rates);
+
+#endif // CGROUP_H
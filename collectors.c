@@ -0,0 +1,480 @@
+#include <poll.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include "collectors.h"
+#include "scheduler.h"
+
+#define MAX_COLLECTORS 16
+
+// Every started collector, so forked workers can drop the channels that belong to their siblings
+static collector* active_collectors[MAX_COLLECTORS];
+static int num_active = 0;
+
+// Collector served by the calling thread, its samples go to the ring instead of the pipe
+static __thread collector* ring_writer = NULL;
+
+bool parseExecMode(const char* name, exec_mode* mode){
+    /**
+    * Converts the value of the --mode= argument into an execution model
+    *
+    * @name: string given on the command line ("fork", "process" or "thread")
+    * @mode: pointer to the exec_mode that receives the result
+    *
+    * Return: true if the name was recognised, false otherwise
+    */
+
+    if (strcmp(name, "fork") == 0){ *mode = MODE_FORK; }
+    else if (strcmp(name, "process") == 0){ *mode = MODE_PROCESS; }
+    else if (strcmp(name, "thread") == 0){ *mode = MODE_THREAD; }
+    else { return false; }
+
+    return true;
+}
+
+static void closeSiblingChannels(collector* self){
+    /**
+    * Closes the parent side of every other collector's pipes inside a freshly forked worker
+    *
+    * @self: the collector the worker belongs to
+    *
+    * Without this a worker would keep its siblings' command pipes open and they would never see end of file
+    */
+
+    for (int j = 0; j < num_active; j++){
+        collector* other = active_collectors[j];
+        if (other == self || other->mode != MODE_PROCESS){ continue; }
+        close(other->command[1]);
+        close(other->data[0]);
+    }
+}
+
+static void publishSample(collector* c){
+    /**
+    * Hands the sample written by the collector thread to the monitor
+    *
+    * @c: collector whose sample is complete
+    *
+    * The channel is only signalled with a system call when the monitor is waiting for it
+    */
+
+    if (c->writing == NULL){
+        // A collector that failed wrote nothing, the empty message tells the monitor
+        c->writing = calloc(1, sizeof(ring_message));
+        if (c->writing == NULL){ return; }
+    }
+
+    // At most one sample is outstanding, a full ring only means the monitor has not popped the previous one yet
+    while (!ringPush(&c->ready, c->writing)){ sched_yield(); }
+    c->writing = NULL;
+
+    // Pairs with the fence in collectorArm: either the monitor sees the sample or this sees the monitor waiting
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&c->waiting, memory_order_relaxed)){
+        uint64_t one = 1;
+        if (write(c->wake, &one, sizeof(one)) == -1){ perror("Error signalling the monitor"); }
+    }
+}
+
+static void collectorLoop(collector* c){
+    /**
+    * Body of a persistent worker, takes one sample for every byte received on the command pipe
+    *
+    * @c: the collector being served
+    *
+    * Returns when the command pipe is closed by the monitor
+    */
+
+    char command;
+    ssize_t result;
+
+    while ((result = read(c->command[0], &command, 1)) != 0){
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            perror("Error reading collector command");
+            break;
+        }
+        c->collect(c->data);
+        if (c->mode == MODE_THREAD){ publishSample(c); }
+    }
+
+    close(c->command[0]);
+    if (c->mode != MODE_THREAD){ close(c->data[1]); }
+}
+
+static void* collectorThread(void* arg){
+    /**
+    * Entry point of a worker thread
+    *
+    * @arg: pointer to the collector being served
+    *
+    * Ctrl-C and Ctrl-Z are blocked so that they only reach the event loop of the monitor
+    */
+
+    ring_writer = (collector*) arg;
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTSTP);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+
+    collectorLoop((collector*) arg);
+    return NULL;
+}
+
+static void ignoreTerminalSignals(){
+    /**
+    * Workers leave Ctrl-C and Ctrl-Z to the monitor, they exit on their own once the monitor closes their channels
+    */
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+}
+
+void startCollector(collector* c, exec_mode mode, void (*collect)(int pipefd[2])){
+    /**
+    * Starts a collector in the selected execution model
+    *
+    * @c: collector to initialize
+    * @mode: execution model, fork spawns nothing here since a child is forked for every sample
+    * @collect: function that takes one sample and writes it to pipefd[1]
+    *
+    * Process and thread workers are started once and keep their command and data pipes for the whole run
+    */
+
+    c->collect = collect;
+    c->mode = mode;
+    c->pid = -1;
+    c->pending = false;
+
+    if (num_active < MAX_COLLECTORS){ active_collectors[num_active++] = c; }
+    if (mode == MODE_FORK){ return; }
+
+    collectors_threaded = (mode == MODE_THREAD);
+
+    // Threads share the address space, only the request goes through a pipe
+    c->data[0] = c->data[1] = -1;
+    if (pipe(c->command) == -1 || (mode != MODE_THREAD && pipe(c->data) == -1)) {
+        fprintf(stderr, "Error: pipe creation failed. (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    if (mode == MODE_THREAD){
+        ringInit(&c->ready);
+        ringInit(&c->recycled);
+        c->writing = c->reading = NULL;
+        c->read_offset = 0;
+        atomic_init(&c->waiting, false);
+        c->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (c->wake == -1){
+            fprintf(stderr, "Error: eventfd creation failed. (%s)\n", strerror(errno));
+            exit(1);
+        }
+
+        int result = pthread_create(&c->thread, NULL, collectorThread, c);
+        if (result != 0){
+            fprintf(stderr, "Error: thread creation failed. (%s)\n", strerror(result));
+            exit(1);
+        }
+        return;
+    }
+
+    c->pid = fork();
+
+    if (c->pid == -1) {
+        fprintf(stderr, "Error: fork failed. (%s)\n", strerror(errno));
+        exit(1);
+    }
+    else if (c->pid == 0) {
+        // Child process
+        close(c->command[1]); close(c->data[0]); // Close unused ends
+        closeSiblingChannels(c);
+        ignoreTerminalSignals();
+        collectorLoop(c);
+        exit(0);
+    }
+
+    // Parent process keeps the write end of the command pipe and the read end of the data pipe
+    close(c->command[0]); close(c->data[1]);
+}
+
+void requestSample(collector* c){
+    /**
+    * Asks a collector for a new sample without waiting for it
+    *
+    * @c: collector to trigger
+    *
+    * Persistent workers are woken up through their command pipe, in fork mode a new child is created.
+    * A collector whose previous sample has not been consumed yet is not asked again, that sample is read first.
+    */
+
+    if (c->pending){ return; }
+    c->pending = true;
+
+    if (c->mode != MODE_FORK){
+        char command = 's';
+        if (write(c->command[1], &command, 1) == -1){
+            perror("Error writing collector command");
+            exit(1);
+        }
+        return;
+    }
+
+    if (pipe(c->data) == -1) {
+        fprintf(stderr, "Error: pipe creation failed. (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    c->pid = fork();
+
+    if (c->pid == -1) {
+        fprintf(stderr, "Error: fork failed. (%s)\n", strerror(errno));
+        exit(1);
+    }
+    else if (c->pid == 0) {
+        // Child process
+        close(c->data[0]); // Close unused read
+        closeSiblingChannels(c);
+        ignoreTerminalSignals();
+        c->collect(c->data);
+        close(c->data[1]);
+        exit(0);
+    }
+
+    // Close the write end of the pipe for the parent
+    close(c->data[1]);
+}
+
+bool sampleReady(collector* c){
+    /**
+    * Return: true if the requested sample can be read without waiting
+    */
+
+    if (c->mode == MODE_THREAD){ return c->reading != NULL || !ringEmpty(&c->ready); }
+
+    struct pollfd readable = { .fd = c->data[0], .events = POLLIN };
+    return poll(&readable, 1, 0) == 1;
+}
+
+bool sampleWait(collector* c, long long deadline){
+    /**
+    * Waits until the requested sample can be read
+    *
+    * @c: collector that was asked for a sample
+    * @deadline: monotonic time in nanoseconds to give up at, 0 to wait as long as it takes
+    *
+    * Return: true if the sample is ready, false if the deadline passed first
+    */
+
+    while (!collectorArm(c)){
+        long long left = deadline > 0 ? deadline - monotonicNow() : -1;
+        if (deadline > 0 && left <= 0){
+            collectorDisarm(c);
+            return false;
+        }
+
+        struct pollfd readable = { .fd = collectorChannel(c), .events = POLLIN };
+        int timeout = left < 0 ? -1 : (int)((left + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+        int result = poll(&readable, 1, timeout);
+        collectorDisarm(c);
+        if (result == -1 && errno != EINTR){ return false; }
+    }
+
+    return true;
+}
+
+int collectorChannel(collector* c){
+    /**
+    * Return: file descriptor that becomes readable when the requested sample is, for poll or epoll
+    */
+
+    return c->mode == MODE_THREAD ? c->wake : c->data[0];
+}
+
+bool collectorArm(collector* c){
+    /**
+    * Prepares to wait on collectorChannel for the requested sample
+    *
+    * @c: collector that was asked for a sample
+    *
+    * A thread only signals its channel while the monitor is waiting, the flag is raised before the last check
+    * so a sample published after that check always signals. Every wait ends with collectorDisarm.
+    *
+    * Return: true if the sample is already ready and there is nothing to wait for
+    */
+
+    if (c->mode == MODE_THREAD){
+        atomic_store_explicit(&c->waiting, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    if (!sampleReady(c)){ return false; }
+
+    if (c->mode == MODE_THREAD){ atomic_store_explicit(&c->waiting, false, memory_order_relaxed); }
+    return true;
+}
+
+void collectorDisarm(collector* c){
+    /**
+    * Ends a wait started by collectorArm, a signal that raced with the last check is consumed here
+    */
+
+    if (c->mode != MODE_THREAD){ return; }
+
+    atomic_store_explicit(&c->waiting, false, memory_order_relaxed);
+    uint64_t count;
+    if (read(c->wake, &count, sizeof(count)) == -1 && errno != EAGAIN){ perror("Error reading collector channel"); }
+}
+
+ssize_t collectorRead(collector* c, void* buffer, size_t size){
+    /**
+    * Reads the next part of the requested sample, waiting for it if needed
+    *
+    * @c: collector that was asked for a sample
+    * @buffer: destination of the data
+    * @size: number of bytes expected
+    *
+    * A thread's sample is copied straight out of its ring message, without a system call
+    *
+    * Return: number of bytes read, less than size at the end of the sample, -1 on error
+    */
+
+    if (c->mode != MODE_THREAD){ return readFull(c->data[0], buffer, size); }
+
+    if (c->reading == NULL){
+        sampleWait(c, 0);
+        c->reading = ringPop(&c->ready);
+        c->read_offset = 0;
+    }
+
+    size_t left = c->reading->length - c->read_offset;
+    if (size > left){ size = left; }
+    memcpy(buffer, c->reading->data + c->read_offset, size);
+    c->read_offset += size;
+    return size;
+}
+
+ssize_t collectorWrite(int pipefd[2], const void* data, size_t size){
+    /**
+    * Writes part of a sample from a collector
+    *
+    * @pipefd: data pipe of the collector, used by processes
+    * @data, size: bytes to write
+    *
+    * On a collector thread the bytes are appended to the message that is published once the sample is complete
+    *
+    * Return: number of bytes written, -1 on error
+    */
+
+    collector* c = ring_writer;
+    if (c == NULL){
+        size_t written = 0;
+        while (written < size){
+            ssize_t result = write(pipefd[1], (const char*) data + written, size - written);
+            if (result == -1){
+                if (errno == EINTR){ continue; }
+                return -1;
+            }
+            written += result;
+        }
+        return written;
+    }
+
+    // Messages handed back by the monitor are reused, so their buffers are already large enough
+    if (c->writing == NULL){
+        c->writing = ringPop(&c->recycled);
+        if (c->writing == NULL){ c->writing = calloc(1, sizeof(ring_message)); }
+        if (c->writing == NULL){ return -1; }
+        c->writing->length = 0;
+    }
+    if (!messageAppend(c->writing, data, size)){
+        errno = ENOMEM;
+        return -1;
+    }
+    return size;
+}
+
+void finishSample(collector* c){
+    /**
+    * Releases the per-sample resources once the sample has been read
+    *
+    * @c: collector whose sample was consumed
+    *
+    * In fork mode the pipe is closed and the child is reaped, a thread gets its message back for the next sample
+    */
+
+    c->pending = false;
+
+    if (c->mode == MODE_THREAD){
+        if (c->reading == NULL){ c->reading = ringPop(&c->ready); }
+        if (c->reading != NULL && !ringPush(&c->recycled, c->reading)){
+            free(c->reading->data);
+            free(c->reading);
+        }
+        c->reading = NULL;
+        return;
+    }
+    if (c->mode != MODE_FORK){ return; }
+
+    close(c->data[0]);
+    waitpid(c->pid, NULL, 0);
+}
+
+void stopCollector(collector* c){
+    /**
+    * Shuts a persistent collector down by closing its command pipe and waits for it to exit
+    *
+    * @c: collector to stop
+    *
+    * A sample that was requested but not read is dropped, a worker blocked writing it gets a broken pipe
+    */
+
+    if (c->mode == MODE_FORK){
+        if (c->pending){ finishSample(c); }
+        return;
+    }
+
+    close(c->command[1]);
+
+    if (c->mode == MODE_THREAD){
+        pthread_join(c->thread, NULL);
+        if (c->reading != NULL){
+            free(c->reading->data);
+            free(c->reading);
+        }
+        ringFree(&c->ready);
+        ringFree(&c->recycled);
+        close(c->wake);
+        c->reading = NULL;
+        return;
+    }
+
+    close(c->data[0]);
+    waitpid(c->pid, NULL, 0);
+}
+
+ssize_t readFull(int fd, void* buffer, size_t size){
+    /**
+    * Reads exactly size bytes from a pipe, retrying on short reads and interrupted calls
+    *
+    * @fd: file descriptor to read from
+    * @buffer: destination of the data
+    * @size: number of bytes expected
+    *
+    * Return: number of bytes read, less than size on end of file, -1 on error
+    */
+
+    size_t total = 0;
+
+    while (total < size){
+        ssize_t result = read(fd, (char*) buffer + total, size - total);
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            return -1;
+        }
+        if (result == 0){ break; }
+        total += result;
+    }
+
+    return total;
+}
@@ -0,0 +1,63 @@
+#ifndef COLLECTORS_H
+#define COLLECTORS_H
+
+#include <pthread.h>
+#include "stats_functions.h"
+#include "ring.h"
+
+typedef enum exec_mode {
+
+    MODE_FORK,      // fork a new child for every sample
+    MODE_PROCESS,   // pre-forked worker processes that live for the whole run
+    MODE_THREAD     // worker threads inside the monitor process, samples go through lock-free rings instead of pipes
+
+} exec_mode;
+
+typedef struct collector {
+
+    void (*collect)(int pipefd[2]);
+    exec_mode mode;
+    int command[2];
+    int data[2];                // pipe of the samples, unused by threads
+    pid_t pid;
+    pthread_t thread;
+    bool pending;               // a sample was requested and has not been consumed yet
+
+    // Thread mode only
+    spsc_ring ready;            // samples written by the collector, read by the monitor
+    spsc_ring recycled;         // consumed messages handed back to the collector for reuse
+    ring_message* writing;      // sample the collector is writing
+    ring_message* reading;      // sample the monitor is reading
+    size_t read_offset;
+    int wake;                   // eventfd signalled with a sample only while the monitor is waiting for it
+    atomic_bool waiting;
+
+} collector;
+
+bool parseExecMode(const char* name, exec_mode* mode);
+
+void startCollector(collector* c, exec_mode mode, void (*collect)(int pipefd[2]));
+
+void requestSample(collector* c);
+
+bool sampleReady(collector* c);
+
+bool sampleWait(collector* c, long long deadline);
+
+int collectorChannel(collector* c);
+
+bool collectorArm(collector* c);
+
+void collectorDisarm(collector* c);
+
+ssize_t collectorRead(collector* c, void* buffer, size_t size);
+
+ssize_t collectorWrite(int pipefd[2], const void* data, size_t size);
+
+void finishSample(collector* c);
+
+void stopCollector(collector* c);
+
+ssize_t readFull(int fd, void* buffer, size_t size);
+
+#endif // COLLECTORS_H
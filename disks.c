@@ -0,0 +1,214 @@
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "disks.h"
+#include "collectors.h"
+#include "scheduler.h"
+
+#define RAM_MAJOR 1
+#define LOOP_MAJOR 7
+#define DEVICE_CACHE 4096
+
+// Whether a device number is a whole disk, looked up in sysfs once per device and then cached
+typedef struct device_kind {
+
+    unsigned int dev;           // makedev(major, minor) + 1, 0 marks a free slot
+    bool whole;
+
+} device_kind;
+
+static bool wholeDisk(device_kind cache[DEVICE_CACHE], unsigned int major, unsigned int minor, const char* name, size_t length){
+    /**
+    * Tells whole disks apart from partitions
+    *
+    * @cache: kinds of the devices seen so far
+    * @major, minor: device number from /proc/diskstats
+    * @name, length: device name, not null terminated
+    *
+    * /sys/block only holds whole disks, it is checked the first time a device is seen.
+    * Every later sample costs a single hash lookup per line, so hundreds of namespaces and their partitions stay cheap.
+    *
+    * Return: true for a whole disk
+    */
+
+    unsigned int dev = makedev(major, minor) + 1;
+    size_t h = (dev * 2654435761u) & (DEVICE_CACHE - 1);
+    size_t probes = 0;
+    while (cache[h].dev != 0 && cache[h].dev != dev && probes < DEVICE_CACHE){
+        h = (h + 1) & (DEVICE_CACHE - 1);
+        probes++;
+    }
+    if (probes < DEVICE_CACHE && cache[h].dev == dev){ return cache[h].whole; }
+
+    // Names with a '/' such as cciss/c0d0 appear with a '!' in sysfs
+    char path[64 + DISK_NAME_LENGTH] = "/sys/block/";
+    size_t start = strlen(path);
+    if (length >= DISK_NAME_LENGTH){ length = DISK_NAME_LENGTH - 1; }
+    for (size_t k = 0; k < length; k++){ path[start + k] = name[k] == '/' ? '!' : name[k]; }
+    path[start + length] = '\0';
+
+    struct stat st;
+    bool whole = stat(path, &st) == 0;
+
+    // A full cache only means the check is repeated every sample
+    if (probes < DEVICE_CACHE){
+        cache[h].dev = dev;
+        cache[h].whole = whole;
+    }
+    return whole;
+}
+
+void diskStats(int pipefd[2]){
+    /**
+    * Reads the counters of every whole disk from /proc/diskstats and writes them to the pipe
+    *
+    * @pipefd: pipe whose write end receives the disk count followed by the counters of each disk
+    *
+    * Loop and ram devices are skipped by their major number before the rest of the line is parsed
+    */
+
+    static disk_stats disks;
+    static device_kind cache[DEVICE_CACHE];
+    disks.count = 0;
+
+    // Re-reads the held open /proc/diskstats
+    static proc_file diskstats_file = PROC_FILE_INIT;
+    if (!readProcFile(&diskstats_file, "/proc/diskstats")){ return; }
+    disks.timestamp = monotonicNow();
+
+    // Every line is "major minor name reads merged sectors ms writes merged sectors ms in_flight io_ms weighted_ms ..."
+    const char* end = diskstats_file.buffer + diskstats_file.length;
+    for (const char* line = diskstats_file.buffer; line < end && disks.count < MAX_DISKS; line = procNextLine(line, end)){
+        const char* cursor = line;
+        long int major, minor;
+        if (!procNextInteger(&cursor, end, &major) || !procNextInteger(&cursor, end, &minor)){ continue; }
+        if (major == RAM_MAJOR || major == LOOP_MAJOR){ continue; }
+
+        while (cursor < end && *cursor == ' '){ cursor++; }
+        const char* name = cursor;
+        while (cursor < end && *cursor != ' ' && *cursor != '\n'){ cursor++; }
+        size_t length = cursor - name;
+        if (length == 0 || !wholeDisk(cache, major, minor, name, length)){ continue; }
+
+        disk_counters* d = &disks.disk[disks.count];
+        if (length >= DISK_NAME_LENGTH){ length = DISK_NAME_LENGTH - 1; }
+        memcpy(d->name, name, length);
+        d->name[length] = '\0';
+
+        // The merged counters (columns 2 and 6) are not used
+        long int columns[11];
+        int read_columns = 0;
+        while (read_columns < 11 && procNextInteger(&cursor, end, &columns[read_columns])){ read_columns++; }
+        if (read_columns < 11){ continue; }
+
+        d->field[DISK_READS] = columns[0];
+        d->field[DISK_READ_SECTORS] = columns[2];
+        d->field[DISK_READ_MS] = columns[3];
+        d->field[DISK_WRITES] = columns[4];
+        d->field[DISK_WRITE_SECTORS] = columns[6];
+        d->field[DISK_WRITE_MS] = columns[7];
+        d->field[DISK_IN_FLIGHT] = columns[8];
+        d->field[DISK_IO_MS] = columns[9];
+        d->field[DISK_WEIGHTED_MS] = columns[10];
+        disks.count++;
+    }
+
+    // Only the used entries are sent
+    size_t size = offsetof(disk_stats, disk) + disks.count * sizeof(disk_counters);
+    if (collectorWrite(pipefd, &size, sizeof(size)) == -1 || collectorWrite(pipefd, &disks, size) != (ssize_t) size) {
+        perror("Error writing to pipe");
+        terminateCollector();
+    }
+}
+
+ssize_t readDisks(collector* c, disk_stats* disks){
+    /**
+    * Reads one sample written by diskStats
+    *
+    * @c: collector with a sample ready
+    * @disks: structure that receives the counters
+    *
+    * Return: number of bytes read, -1 on error
+    */
+
+    size_t size;
+    if (collectorRead(c, &size, sizeof(size)) != sizeof(size) || size < offsetof(disk_stats, disk) || size > sizeof(disk_stats)
+        || collectorRead(c, disks, size) != (ssize_t) size){
+        disks->count = 0;
+        return -1;
+    }
+
+    return sizeof(size) + size;
+}
+
+static unsigned long long counterDelta(unsigned long long current, unsigned long long previous){
+    // A device that was reset restarts from zero
+    return current >= previous ? current - previous : 0;
+}
+
+void diskDeltas(const disk_stats* current, disk_stats* previous, disk_rates rates[MAX_DISKS]){
+    /**
+    * Computes the rates of every disk since the previous sample
+    *
+    * @current: counters of this sample
+    * @previous: counters of the previous sample, replaced by the current ones for the next iteration
+    * @rates: array receiving the rates of each disk of current, zero for a disk that just appeared
+    *
+    * Disks are matched by name, the same position is tried first since the order of the file rarely changes
+    */
+
+    double elapsed = previous->count > 0 ? (double)(current->timestamp - previous->timestamp) / NSEC_PER_SEC : 0;
+
+    for (int d = 0; d < current->count; d++){
+        const disk_counters* now = &current->disk[d];
+        memset(&rates[d], 0, sizeof(disk_rates));
+
+        const disk_counters* before = NULL;
+        if (d < previous->count && strcmp(previous->disk[d].name, now->name) == 0){ before = &previous->disk[d]; }
+        for (int k = 0; before == NULL && k < previous->count; k++){
+            if (strcmp(previous->disk[k].name, now->name) == 0){ before = &previous->disk[k]; }
+        }
+        if (before == NULL || elapsed <= 0){ continue; }
+
+        unsigned long long delta[DISK_FIELDS];
+        for (int f = 0; f < DISK_FIELDS; f++){ delta[f] = counterDelta(now->field[f], before->field[f]); }
+
+        unsigned long long completed = delta[DISK_READS] + delta[DISK_WRITES];
+        rates[d].read_iops = delta[DISK_READS] / elapsed;
+        rates[d].write_iops = delta[DISK_WRITES] / elapsed;
+        rates[d].read_bytes = (double) delta[DISK_READ_SECTORS] * SECTOR_SIZE / elapsed;
+        rates[d].write_bytes = (double) delta[DISK_WRITE_SECTORS] * SECTOR_SIZE / elapsed;
+        rates[d].service_ms = completed > 0 ? (double) delta[DISK_IO_MS] / completed : 0;
+        rates[d].queue_depth = delta[DISK_WEIGHTED_MS] / (elapsed * 1000);
+        rates[d].utilization = delta[DISK_IO_MS] / (elapsed * 10);
+        if (rates[d].utilization > 100){ rates[d].utilization = 100; }
+    }
+
+    previous->timestamp = current->timestamp;
+    previous->count = current->count;
+    memcpy(previous->disk, current->disk, current->count * sizeof(disk_counters));
+}
+
+void diskOutput(frame* f, bool graphics, const disk_stats* disks, const disk_rates rates[MAX_DISKS]){
+    /**
+    * Prints the throughput and latency of every disk
+    *
+    * @f: frame the output is added to
+    * @graphics: boolean value indicating whether graphics option has been selected
+    * @disks: counters of the current sample, for the device names
+    * @rates: rates computed by diskDeltas
+    *
+    * With graphics a bar is added for every 2 percent of utilization, like the per-core cpu bars
+    */
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Disks ### (r/s w/s rMB/s wMB/s svc ms queue util)\n");
+
+    for (int d = 0; d < disks->count; d++){
+        const disk_rates* r = &rates[d];
+        char bars[64];
+        frameBar(bars, sizeof(bars), graphics, r->utilization);
+        framePrintf(f, " %-12s %8.1f %8.1f %8.2f %8.2f %7.2f %6.2f %6.2f%%%s\n", disks->disk[d].name, r->read_iops, r->write_iops,
+                    r->read_bytes / (1024 * 1024), r->write_bytes / (1024 * 1024), r->service_ms, r->queue_depth, r->utilization, bars);
+    }
+}
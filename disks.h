@@ -0,0 +1,63 @@
+#ifndef DISKS_H
+#define DISKS_H
+
+#include "stats_functions.h"
+
+#define MAX_DISKS 1024
+#define DISK_NAME_LENGTH 32
+#define SECTOR_SIZE 512         // /proc/diskstats counts 512 byte sectors whatever the device block size
+
+// Columns of /proc/diskstats after the device name that are used
+enum disk_field {
+
+    DISK_READS,
+    DISK_READ_SECTORS,
+    DISK_READ_MS,
+    DISK_WRITES,
+    DISK_WRITE_SECTORS,
+    DISK_WRITE_MS,
+    DISK_IN_FLIGHT,
+    DISK_IO_MS,                 // time the device had requests in flight
+    DISK_WEIGHTED_MS,           // time in flight summed over every request
+    DISK_FIELDS
+
+};
+
+typedef struct disk_counters {
+
+    char name[DISK_NAME_LENGTH];
+    unsigned long long field[DISK_FIELDS];
+
+} disk_counters;
+
+// Counters of every whole disk at one sample, partitions, loop and ram devices are left out
+typedef struct disk_stats {
+
+    long long timestamp;        // monotonic time of the read in nanoseconds
+    int count;
+    disk_counters disk[MAX_DISKS];
+
+} disk_stats;
+
+// Rates of one disk between two samples
+typedef struct disk_rates {
+
+    double read_iops;
+    double write_iops;
+    double read_bytes;          // bytes per second
+    double write_bytes;
+    double service_ms;          // busy time per completed request
+    double queue_depth;         // average number of requests in flight
+    double utilization;         // percent of the time the device was busy
+
+} disk_rates;
+
+void diskStats(int pipefd[2]);
+
+ssize_t readDisks(struct collector* c, disk_stats* disks);
+
+void diskDeltas(const disk_stats* current, disk_stats* previous, disk_rates rates[MAX_DISKS]);
+
+void diskOutput(frame* f, bool graphics, const disk_stats* disks, const disk_rates rates[MAX_DISKS]);
+
+#endif // DISKS_H
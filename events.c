@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "events.h"
+#include "scheduler.h"
+
+// Sources of the epoll instance, a channel keeps its tag in the upper bits
+enum event_source { SOURCE_TIMER, SOURCE_SIGNAL, SOURCE_INPUT, SOURCE_CHANNEL };
+
+static bool addSource(event_loop* l, int fd, enum event_source source, int tag){
+    struct epoll_event watched = { .events = EPOLLIN, .data.u64 = (uint64_t) source | ((uint64_t) tag << 8) };
+    return epoll_ctl(l->epoll_fd, EPOLL_CTL_ADD, fd, &watched) == 0;
+}
+
+bool eventLoopInit(event_loop* l, bool input){
+    /**
+    * Creates the event loop of the monitor and takes over the signals it handles
+    *
+    * @l: loop to initialize
+    * @input: watch standard input, for the answer to the quit confirmation
+    *
+    * The signals are blocked and read from a signalfd instead of running a handler, so they are handled
+    * between two waits like any other event. Must be called before any thread is started, threads inherit
+    * the blocked set and a signal must not be delivered to one of them.
+    *
+    * Return: false on error (a message has been printed)
+    */
+
+    memset(l, 0, sizeof(event_loop));
+
+    sigset_t handled;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGTERM);
+    sigaddset(&handled, SIGTSTP);
+    sigaddset(&handled, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &handled, NULL);
+
+    l->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    l->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    l->signal_fd = signalfd(-1, &handled, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (l->epoll_fd == -1 || l->timer_fd == -1 || l->signal_fd == -1
+        || !addSource(l, l->timer_fd, SOURCE_TIMER, 0) || !addSource(l, l->signal_fd, SOURCE_SIGNAL, 0)){
+        fprintf(stderr, "Error: failed to create the event loop. (%s)\n", strerror(errno));
+        return false;
+    }
+
+    // Standard input redirected from a regular file cannot be watched, Ctrl-C then quits without asking
+    l->input = input && addSource(l, STDIN_FILENO, SOURCE_INPUT, 0);
+
+    return true;
+}
+
+bool eventWatch(event_loop* l, int fd, int tag){
+    /**
+    * Adds a collector channel to the loop
+    *
+    * @l: event loop
+    * @fd: channel of the collector, see collectorChannel
+    * @tag: number returned with the EVENT_CHANNEL of this channel, at least 0
+    *
+    * Return: false on error
+    */
+
+    if (addSource(l, fd, SOURCE_CHANNEL, tag)){ return true; }
+    fprintf(stderr, "Error: failed to watch a collector channel. (%s)\n", strerror(errno));
+    return false;
+}
+
+void eventUnwatch(event_loop* l, int fd){
+    epoll_ctl(l->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void eventInputClosed(event_loop* l){
+    /**
+    * Stops watching standard input once it reached its end, it would otherwise stay readable forever
+    */
+
+    if (!l->input){ return; }
+    eventUnwatch(l, STDIN_FILENO);
+    l->input = false;
+}
+
+static bool armTimer(event_loop* l, long long deadline){
+    if (deadline == l->armed){ return true; }
+
+    // An absolute deadline in the past fires at once, a zero value disarms the timer
+    struct itimerspec timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value.tv_sec = deadline / NSEC_PER_SEC;
+    timer.it_value.tv_nsec = deadline % NSEC_PER_SEC;
+    if (timerfd_settime(l->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) == -1){ return false; }
+
+    l->armed = deadline;
+    return true;
+}
+
+event eventNext(event_loop* l, long long deadline){
+    /**
+    * Waits for the next event
+    *
+    * @l: event loop
+    * @deadline: monotonic time in nanoseconds the wait ends at with EVENT_TIMEOUT, 0 to wait for an event however long it takes
+    *
+    * The deadline is a timerfd armed with an absolute time, so a wait that is interrupted by other events and
+    * resumed still ends exactly on it. Sources are level triggered: a readable channel or standard input is
+    * reported again until it is read or unwatched.
+    *
+    * Return: the event
+    */
+
+    event e = { EVENT_ERROR, 0, 0 };
+    if (!armTimer(l, deadline)){
+        fprintf(stderr, "Error: failed to arm the timer. (%s)\n", strerror(errno));
+        return e;
+    }
+
+    while (true){
+        struct epoll_event ready;
+        int result = epoll_wait(l->epoll_fd, &ready, 1, -1);
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            fprintf(stderr, "Error: epoll_wait failed. (%s)\n", strerror(errno));
+            return e;
+        }
+
+        switch ((enum event_source)(ready.data.u64 & 0xff)){
+            case SOURCE_TIMER: {
+                // Nothing to read means the timer was re-armed after it fired, the wait goes on
+                uint64_t expirations;
+                if (read(l->timer_fd, &expirations, sizeof(expirations)) == -1){ continue; }
+                l->armed = 0;
+                e.type = EVENT_TIMEOUT;
+                return e;
+            }
+            case SOURCE_SIGNAL: {
+                struct signalfd_siginfo info;
+                if (read(l->signal_fd, &info, sizeof(info)) != sizeof(info)){ continue; }
+                e.type = EVENT_SIGNAL;
+                e.signal = info.ssi_signo;
+                return e;
+            }
+            case SOURCE_INPUT:
+                e.type = EVENT_INPUT;
+                return e;
+            case SOURCE_CHANNEL:
+                e.type = EVENT_CHANNEL;
+                e.tag = (int)(ready.data.u64 >> 8);
+                return e;
+        }
+    }
+}
+
+void eventLoopClose(event_loop* l){
+    close(l->epoll_fd);
+    close(l->timer_fd);
+    close(l->signal_fd);
+}
@@ -0,0 +1,49 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <signal.h>
+
+// What woke the monitor up
+enum event_type {
+
+    EVENT_TIMEOUT,              // the deadline of the wait passed
+    EVENT_SIGNAL,               // one of the handled signals arrived, its number is in signal
+    EVENT_INPUT,                // standard input can be read, or reached its end
+    EVENT_CHANNEL,              // a watched collector channel became readable, its tag is in tag
+    EVENT_ERROR                 // the wait failed (a message has been printed)
+
+};
+
+typedef struct event {
+
+    enum event_type type;
+    int signal;
+    int tag;
+
+} event;
+
+// Everything the monitor waits on, multiplexed by one epoll instance
+typedef struct event_loop {
+
+    int epoll_fd;
+    int timer_fd;               // timerfd armed at the absolute deadline of the current wait
+    int signal_fd;              // SIGINT, SIGTERM, SIGTSTP and SIGWINCH, blocked in every thread
+    long long armed;            // deadline the timer is set to, 0 when it is disarmed
+    bool input;                 // standard input is watched
+
+} event_loop;
+
+bool eventLoopInit(event_loop* l, bool input);
+
+bool eventWatch(event_loop* l, int fd, int tag);
+
+void eventUnwatch(event_loop* l, int fd);
+
+void eventInputClosed(event_loop* l);
+
+event eventNext(event_loop* l, long long deadline);
+
+void eventLoopClose(event_loop* l);
+
+#endif // EVENTS_H
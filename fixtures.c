@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <utmp.h>
+#include <sys/stat.h>
+#include "fixtures.h"
+#include "stats_functions.h"
+
+// Keys of a /proc/meminfo file in kernel order, in kB
+static const struct { const char* name; long int kb; } meminfo_fixture[] = {
+    { "MemTotal", 65536000 }, { "MemFree", 20480000 }, { "MemAvailable", 48000000 }, { "Buffers", 512000 },
+    { "Cached", 24000000 }, { "SwapCached", 1024 }, { "Active", 18000000 }, { "Inactive", 16000000 },
+    { "Active(anon)", 9000000 }, { "Inactive(anon)", 400000 }, { "Active(file)", 9000000 }, { "Inactive(file)", 15600000 },
+    { "Unevictable", 0 }, { "Mlocked", 0 }, { "SwapTotal", 8388604 }, { "SwapFree", 8300000 },
+    { "Zswap", 0 }, { "Zswapped", 0 }, { "Dirty", 2048 }, { "Writeback", 0 },
+    { "AnonPages", 9400000 }, { "Mapped", 1200000 }, { "Shmem", 300000 }, { "KReclaimable", 900000 },
+    { "Slab", 1400000 }, { "SReclaimable", 900000 }, { "SUnreclaim", 500000 }, { "KernelStack", 40000 },
+    { "PageTables", 120000 }, { "SecPageTables", 0 }, { "NFS_Unstable", 0 }, { "Bounce", 0 },
+    { "WritebackTmp", 0 }, { "CommitLimit", 41156604 }, { "Committed_AS", 30000000 }, { "VmallocTotal", 34359738367 },
+    { "VmallocUsed", 200000 }, { "VmallocChunk", 0 }, { "Percpu", 60000 }, { "HardwareCorrupted", 0 },
+    { "AnonHugePages", 2048000 }, { "ShmemHugePages", 0 }, { "ShmemPmdMapped", 0 }, { "FileHugePages", 0 },
+    { "FilePmdMapped", 0 }, { "Unaccepted", 0 }, { "HugePages_Total", 0 }, { "HugePages_Free", 0 },
+    { "HugePages_Rsvd", 0 }, { "HugePages_Surp", 0 }, { "Hugepagesize", 2048 }, { "Hugetlb", 0 },
+    { "DirectMap4k", 600000 }, { "DirectMap2M", 30000000 }, { "DirectMap1G", 38000000 }
+};
+
+static FILE* openFixture(const char* dir, const char* name){
+    /**
+    * Creates one file of the fixture directory
+    *
+    * Return: the open file, NULL on error (a message has been printed)
+    */
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL){ fprintf(stderr, "Error: failed to create %s. (%s)\n", path, strerror(errno)); }
+    return fp;
+}
+
+static bool closeFixture(FILE* fp, const char* name){
+    /**
+    * Return: false if the buffered contents could not be written (a message has been printed)
+    */
+
+    if (ferror(fp) | fclose(fp)){
+        fprintf(stderr, "Error: failed to write the %s fixture. (%s)\n", name, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool writeStat(const char* dir, int cpus){
+    /**
+    * Writes a /proc/stat with the aggregate line, one cpuN line per cpu and the usual trailing lines
+    */
+
+    FILE* fp = openFixture(dir, "stat");
+    if (fp == NULL){ return false; }
+
+    // Counters grow with the cpu number so every column has a different width somewhere in the file
+    long int base = 1000003;
+    fprintf(fp, "cpu  %ld %ld %ld %ld %ld %ld %ld %ld 0 0\n", base * cpus, base / 10 * cpus, base / 2 * cpus, base * 40 * cpus,
+            base / 20 * cpus, 0L, base / 50 * cpus, 0L);
+    for (int c = 0; c < cpus; c++){
+        long int v = base + c * 7919;
+        fprintf(fp, "cpu%d %ld %ld %ld %ld %ld %ld %ld %ld 0 0\n", c, v, v / 10, v / 2, v * 40, v / 20, 0L, v / 50, 0L);
+    }
+    fprintf(fp, "intr 123456789 0 9 0 0 0 0 0 0 0 0\n");
+    fprintf(fp, "ctxt 987654321\nbtime 1700000000\nprocesses 4242424\nprocs_running %d\nprocs_blocked 0\n", cpus > 4 ? 4 : cpus);
+    fprintf(fp, "softirq 55555555 0 1111 2222 3333 4444 0 5555 6666 0 7777\n");
+
+    return closeFixture(fp, "stat");
+}
+
+static bool writeMeminfo(const char* dir){
+    /**
+    * Writes a /proc/meminfo with every key of a recent kernel
+    */
+
+    FILE* fp = openFixture(dir, "meminfo");
+    if (fp == NULL){ return false; }
+
+    for (size_t k = 0; k < sizeof(meminfo_fixture) / sizeof(meminfo_fixture[0]); k++){
+        char key[32];
+        snprintf(key, sizeof(key), "%s:", meminfo_fixture[k].name);
+        fprintf(fp, "%-16s%8ld kB\n", key, meminfo_fixture[k].kb);
+    }
+
+    return closeFixture(fp, "meminfo");
+}
+
+static bool writeUtmp(const char* dir, int sessions){
+    /**
+    * Writes a utmp file with a boot record followed by one USER_PROCESS record per session
+    */
+
+    FILE* fp = openFixture(dir, "utmp");
+    if (fp == NULL){ return false; }
+
+    struct utmp record;
+    memset(&record, 0, sizeof(record));
+    record.ut_type = BOOT_TIME;
+    strncpy(record.ut_line, "~", sizeof(record.ut_line));
+    strncpy(record.ut_user, "reboot", sizeof(record.ut_user));
+    record.ut_tv.tv_sec = 1700000000;
+    fwrite(&record, sizeof(record), 1, fp);
+
+    for (int s = 0; s < sessions; s++){
+        memset(&record, 0, sizeof(record));
+        record.ut_type = USER_PROCESS;
+        record.ut_pid = 10000 + s;
+        snprintf(record.ut_line, sizeof(record.ut_line), "pts/%d", s);
+        // ut_id holds up to 4 characters without a terminator
+        char id[16];
+        snprintf(id, sizeof(id), "%04d", s % 10000);
+        memcpy(record.ut_id, id, sizeof(record.ut_id));
+        snprintf(record.ut_user, sizeof(record.ut_user), "user%05d", s);
+        snprintf(record.ut_host, sizeof(record.ut_host), "10.%d.%d.%d", (s >> 16) & 255, (s >> 8) & 255, s & 255);
+        record.ut_tv.tv_sec = 1700000000 + s;
+        fwrite(&record, sizeof(record), 1, fp);
+    }
+
+    return closeFixture(fp, "utmp");
+}
+
+bool writeFixtures(const char* dir, int cpus, int sessions){
+    /**
+    * Writes a synthetic stat, meminfo and utmp into a directory, for --proc-root=DIR --utmp=DIR/utmp
+    *
+    * @dir: directory that receives the files, created if it does not exist
+    * @cpus: number of cpuN lines in stat, 1 to MAX_CPUS
+    * @sessions: number of user sessions in utmp, 0 to FIXTURE_MAX_SESSIONS
+    *
+    * The files have the layout of a recent kernel and glibc, so the collectors parse them exactly like the real ones
+    *
+    * Return: true on success, false on error (a message has been printed)
+    */
+
+    if (cpus < 1 || cpus > MAX_CPUS || sessions < 0 || sessions > FIXTURE_MAX_SESSIONS){
+        fprintf(stderr, "Error: fixtures need 1 to %d cpus and 0 to %d sessions\n", MAX_CPUS, FIXTURE_MAX_SESSIONS);
+        return false;
+    }
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST){
+        fprintf(stderr, "Error: failed to create %s. (%s)\n", dir, strerror(errno));
+        return false;
+    }
+
+    return writeStat(dir, cpus) && writeMeminfo(dir) && writeUtmp(dir, sessions);
+}
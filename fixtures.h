@@ -0,0 +1,10 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <stdbool.h>
+
+#define FIXTURE_MAX_SESSIONS 100000
+
+bool writeFixtures(const char* dir, int cpus, int sessions);
+
+#endif // FIXTURES_H
@@ -0,0 +1,72 @@
+#include "history.h"
+
+bool historyInit(history* h, int capacity){
+    /**
+    * Allocates a ring buffer for capacity samples, this is the only allocation of the history
+    *
+    * @h: history to initialize
+    * @capacity: number of samples kept, older samples are overwritten
+    *
+    * Return: true on success, false if capacity is not positive or the allocation failed
+    */
+
+    h->count = 0;
+    h->head = 0;
+    h->appended = 0;
+    h->capacity = capacity;
+    h->samples = NULL;
+
+    if (capacity <= 0){ return false; }
+
+    h->samples = calloc(capacity, sizeof(sample));
+    return h->samples != NULL;
+}
+
+void historyFree(history* h){
+    /**
+    * Releases the ring buffer
+    */
+
+    free(h->samples);
+    h->samples = NULL;
+    h->capacity = 0;
+    h->count = 0;
+}
+
+sample* historyAppend(history* h){
+    /**
+    * Reserves the slot of a new sample in O(1), overwriting the oldest sample once the buffer is full
+    *
+    * @h: history to append to
+    *
+    * Return: pointer to the zeroed slot that the caller fills in
+    */
+
+    sample* slot = &h->samples[h->head];
+    memset(slot, 0, sizeof(sample));
+
+    h->head = (h->head + 1) % h->capacity;
+    if (h->count < h->capacity){ h->count++; }
+    h->appended++;
+
+    return slot;
+}
+
+const sample* historyGet(const history* h, int k){
+    /**
+    * Return: the k-th stored sample, 0 being the oldest and count - 1 the newest, NULL if out of range
+    */
+
+    if (k < 0 || k >= h->count){ return NULL; }
+
+    int oldest = (h->head - h->count + h->capacity) % h->capacity;
+    return &h->samples[(oldest + k) % h->capacity];
+}
+
+const sample* historyLatest(const history* h){
+    /**
+    * Return: the newest sample, NULL if the history is empty
+    */
+
+    return historyGet(h, h->count - 1);
+}
@@ -0,0 +1,18 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "stats_functions.h"
+
+#define DEFAULT_HISTORY 1024
+
+bool historyInit(history* h, int capacity);
+
+void historyFree(history* h);
+
+sample* historyAppend(history* h);
+
+const sample* historyGet(const history* h, int k);
+
+const sample* historyLatest(const history* h);
+
+#endif // HISTORY_H
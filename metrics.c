@@ -0,0 +1,555 @@
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "metrics.h"
+#include "collectors.h"
+#include "scheduler.h"
+
+#define METRICS_PAGE_CAPACITY 16384
+
+static const char* cpu_modes[CORE_FIELDS] = { "user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal", "guest", "guest_nice" };
+
+static const char not_found[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 24\r\nConnection: close\r\n\r\n"
+                                "metrics are at /metrics\n";
+static const char unavailable[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 15\r\nConnection: close\r\n\r\n"
+                                  "no sample yet.\n";
+
+static const char bad_request[] = "HTTP/1.1 400 Bad Request\r\nContent-Type: text/plain\r\nContent-Length: 20\r\nConnection: close\r\n\r\n"
+                                  "invalid range query\n";
+
+static const char* series_names[RETAIN_SERIES] = { "cpu_use", "memory_used", "memory_available", "virtual_used", "procs_running" };
+
+static int listenUnix(const char* path){
+    /**
+    * Return: a listening unix socket bound to path, -1 on error (errno is set)
+    */
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)){
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    // A socket file left behind by a previous run is replaced, any other file is kept
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)){ unlink(path); }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1){ return -1; }
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address)) == -1 || listen(fd, METRICS_MAX_CLIENTS) == -1){
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int listenTcp(const char* address, int backlog){
+    /**
+    * Opens a non-blocking listening socket, also used by the aggregator of --aggregate
+    *
+    * @address: "ADDR:PORT", "[IPv6]:PORT" or ":PORT" (every interface)
+    * @backlog: connections the kernel queues until they are accepted
+    *
+    * Return: the socket, -1 on error (a message has been printed)
+    */
+
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL || colon - address >= (long) sizeof(host) || colon[1] == '\0'){
+        fprintf(stderr, "Error: invalid listen address '%s', expected ADDR:PORT\n", address);
+        return -1;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    // Brackets around an IPv6 address are not part of the name
+    char* name = host;
+    size_t length = strlen(host);
+    if (length >= 2 && host[0] == '[' && host[length - 1] == ']'){
+        host[length - 1] = '\0';
+        name = host + 1;
+    }
+
+    struct addrinfo hints, *results;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    int result = getaddrinfo(*name == '\0' ? NULL : name, colon + 1, &hints, &results);
+    if (result != 0){
+        fprintf(stderr, "Error: failed to resolve listen address '%s'. (%s)\n", address, gai_strerror(result));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* a = results; a != NULL && fd == -1; a = a->ai_next){
+        fd = socket(a->ai_family, a->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd == -1){ continue; }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) == -1 || listen(fd, backlog) == -1){
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+
+    if (fd == -1){ fprintf(stderr, "Error: failed to listen on %s. (%s)\n", address, strerror(errno)); }
+    return fd;
+}
+
+static void dropClient(metrics_client* c){
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void acceptClients(metrics_server* m){
+    /**
+    * Accepts every pending connection, a connection beyond METRICS_MAX_CLIENTS is closed right away
+    */
+
+    while (true){
+        int fd = accept(m->listen_fd, NULL, NULL);
+        if (fd == -1){ return; }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        metrics_client* free_slot = NULL;
+        for (int k = 0; k < METRICS_MAX_CLIENTS && free_slot == NULL; k++){
+            if (m->clients[k].fd == -1){ free_slot = &m->clients[k]; }
+        }
+        if (free_slot == NULL){
+            close(fd);
+            continue;
+        }
+
+        free_slot->fd = fd;
+        free_slot->request_length = 0;
+        free_slot->response_length = 0;
+        free_slot->sent = 0;
+        free_slot->deadline = monotonicNow() + METRICS_CLIENT_TIMEOUT;
+    }
+}
+
+static bool setResponse(metrics_client* c, const char* text, size_t length){
+    if (c->response_capacity < length){
+        char* larger = realloc(c->response, length);
+        if (larger == NULL){ return false; }
+        c->response = larger;
+        c->response_capacity = length;
+    }
+    memcpy(c->response, text, length);
+    c->response_length = length;
+    return true;
+}
+
+static bool queryParameter(const char* query, const char* name, char* value, size_t size){
+    /**
+    * Copies the value of a parameter of the query string of a request line
+    *
+    * @query: text after the '?', it ends at the first space
+    * @name: parameter to find
+    * @value: receives the value, truncated to size - 1 characters
+    *
+    * Return: true if the parameter is present
+    */
+
+    size_t length = strlen(name);
+    for (const char* p = query; *p != '\0' && *p != ' '; p++){
+        if ((p == query || p[-1] == '&') && strncmp(p, name, length) == 0 && p[length] == '='){
+            p += length + 1;
+            size_t k = 0;
+            while (p[k] != '\0' && p[k] != ' ' && p[k] != '&' && k + 1 < size){
+                value[k] = p[k];
+                k++;
+            }
+            value[k] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool rangeResponse(metrics_server* m, metrics_client* c, const char* query){
+    /**
+    * Exports the retained samples of a time range as CSV, one row per bucket
+    *
+    * @m: server with a retention store
+    * @c: client the response is set for
+    * @query: query string of "GET /range?last=6h&points=60", or "from" and "to" in unix seconds instead of "last",
+    *         everything retained when there is neither, METRICS_RANGE_POINTS buckets when points is not given
+    *
+    * The store picks the finest tier holding the start of the range and merges its buckets down to the points asked
+    *
+    * Return: false if the response could not be allocated
+    */
+
+    char value[64];
+    long long now = realtimeNow(), from = 0, to = now + 1, last;
+    int points = METRICS_RANGE_POINTS;
+    bool valid = true;
+    if (query != NULL && queryParameter(query, "last", value, sizeof(value))){
+        valid = parseInterval(value, &last);
+        from = now - last;
+    }
+    if (query != NULL && queryParameter(query, "from", value, sizeof(value))){ from = (long long)(strtod(value, NULL) * NSEC_PER_SEC); }
+    if (query != NULL && queryParameter(query, "to", value, sizeof(value))){ to = (long long)(strtod(value, NULL) * NSEC_PER_SEC); }
+    if (query != NULL && queryParameter(query, "points", value, sizeof(value))){ valid = valid && sscanf(value, "%d", &points) == 1 && points > 0; }
+    if (!valid || from >= to){ return setResponse(c, bad_request, sizeof(bad_request) - 1); }
+
+    retention_bucket* buckets = malloc(RETENTION_QUERY_MAX * sizeof(retention_bucket));
+    writer body, page;
+    bool ok = buckets != NULL && writerInit(&body, -1, METRICS_PAGE_CAPACITY) && writerInit(&page, -1, METRICS_PAGE_CAPACITY);
+    if (!ok){
+        free(buckets);
+        return false;
+    }
+    int n = retentionQuery(m->store, from, to, points, buckets);
+
+    // Times in seconds, then min, avg, max and last of every figure
+    writerString(&body, "start,duration,samples");
+    for (int k = 0; k < RETAIN_SERIES; k++){
+        writerString(&body, ",");  writerString(&body, series_names[k]); writerString(&body, "_min");
+        writerString(&body, ",");  writerString(&body, series_names[k]); writerString(&body, "_avg");
+        writerString(&body, ",");  writerString(&body, series_names[k]); writerString(&body, "_max");
+        writerString(&body, ",");  writerString(&body, series_names[k]); writerString(&body, "_last");
+    }
+    writerString(&body, "\n");
+    for (int b = 0; b < n; b++){
+        writerFixed(&body, buckets[b].start / 1e9, 3);
+        writerString(&body, ",");
+        writerFixed(&body, buckets[b].duration / 1e9, 3);
+        writerString(&body, ",");
+        writerInteger(&body, buckets[b].samples);
+        double weight = buckets[b].weight > 0 ? buckets[b].weight : 1;
+        for (int k = 0; k < RETAIN_SERIES; k++){
+            const rollup* r = &buckets[b].series[k];
+            writerString(&body, ","); writerFixed(&body, r->min, 3);
+            writerString(&body, ","); writerFixed(&body, r->sum / weight, 3);
+            writerString(&body, ","); writerFixed(&body, r->max, 3);
+            writerString(&body, ","); writerFixed(&body, r->last, 3);
+        }
+        writerString(&body, "\n");
+    }
+
+    writerString(&page, "HTTP/1.1 200 OK\r\nContent-Type: text/csv; charset=utf-8\r\nContent-Length: ");
+    writerInteger(&page, body.length);
+    writerString(&page, "\r\nConnection: close\r\n\r\n");
+    writerBytes(&page, body.buffer, body.length);
+    ok = setResponse(c, page.buffer, page.length);
+
+    free(buckets);
+    writerFree(&body);
+    writerFree(&page);
+    return ok;
+}
+
+static void readRequest(metrics_server* m, metrics_client* c){
+    /**
+    * Reads what has arrived of a request, once its header is complete the response is copied from the cached page
+    */
+
+    ssize_t result = recv(c->fd, c->request + c->request_length, sizeof(c->request) - 1 - c->request_length, 0);
+    if (result == 0 || (result == -1 && errno != EAGAIN && errno != EINTR)){
+        dropClient(c);
+        return;
+    }
+    if (result == -1){ return; }
+
+    c->request_length += result;
+    c->request[c->request_length] = '\0';
+    if (strstr(c->request, "\r\n\r\n") == NULL && strstr(c->request, "\n\n") == NULL){
+        // A header that does not fit is not a scrape
+        if (c->request_length == sizeof(c->request) - 1){ dropClient(c); }
+        return;
+    }
+
+    // Only the request line matters, "GET /metrics HTTP/1.1" with an optional query string
+    bool metrics = strncmp(c->request, "GET /metrics", 12) == 0 && (c->request[12] == ' ' || c->request[12] == '?');
+    bool range = m->store != NULL && strncmp(c->request, "GET /range", 10) == 0 && (c->request[10] == ' ' || c->request[10] == '?');
+    bool ok;
+    if (range){ ok = rangeResponse(m, c, c->request[10] == '?' ? c->request + 11 : NULL); }
+    else if (!metrics){ ok = setResponse(c, not_found, sizeof(not_found) - 1); }
+    else {
+        pthread_mutex_lock(&m->lock);
+        if (m->page_samples == 0){ ok = setResponse(c, unavailable, sizeof(unavailable) - 1); }
+        else { ok = setResponse(c, m->page.buffer, m->page.length); }
+        pthread_mutex_unlock(&m->lock);
+    }
+    if (!ok){ dropClient(c); }
+}
+
+static void writeResponse(metrics_client* c){
+    /**
+    * Sends as much of the response as the socket takes, the connection is closed once all of it is sent
+    */
+
+    ssize_t result = send(c->fd, c->response + c->sent, c->response_length - c->sent, MSG_NOSIGNAL);
+    if (result == -1){
+        if (errno != EAGAIN && errno != EINTR){ dropClient(c); }
+        return;
+    }
+
+    c->sent += result;
+    if (c->sent == c->response_length){
+        shutdown(c->fd, SHUT_WR);
+        dropClient(c);
+    }
+}
+
+static void* metricsThread(void* arg){
+    /**
+    * Serves the scrapes until the wake pipe is closed
+    *
+    * @arg: the metrics_server
+    *
+    * Every socket is non-blocking and multiplexed with poll, a slow or stalled scraper only holds its own slot
+    * until its timeout. The sampling loop never waits for this thread, it only takes the lock to swap in a new page.
+    */
+
+    metrics_server* m = (metrics_server*) arg;
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTSTP);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+
+    struct pollfd fds[METRICS_MAX_CLIENTS + 2];
+    metrics_client* polled[METRICS_MAX_CLIENTS + 2];
+
+    while (true){
+        int count = 0;
+        fds[count++] = (struct pollfd){ .fd = m->wake[0], .events = POLLIN };
+        fds[count++] = (struct pollfd){ .fd = m->listen_fd, .events = POLLIN };
+
+        long long now = monotonicNow();
+        for (int k = 0; k < METRICS_MAX_CLIENTS; k++){
+            metrics_client* c = &m->clients[k];
+            if (c->fd == -1){ continue; }
+            if (now > c->deadline){
+                dropClient(c);
+                continue;
+            }
+            polled[count] = c;
+            fds[count++] = (struct pollfd){ .fd = c->fd, .events = c->response_length > 0 ? POLLOUT : POLLIN };
+        }
+
+        if (poll(fds, count, 1000) == -1){
+            if (errno == EINTR){ continue; }
+            perror("Error polling the metrics sockets");
+            break;
+        }
+        if (fds[0].revents != 0){ break; }
+        if (fds[1].revents & POLLIN){ acceptClients(m); }
+
+        for (int k = 2; k < count; k++){
+            metrics_client* c = polled[k];
+            if (fds[k].revents == 0 || c->fd != fds[k].fd){ continue; }
+            if (c->response_length == 0){ readRequest(m, c); }
+            else { writeResponse(c); }
+        }
+    }
+
+    return NULL;
+}
+
+bool metricsListen(metrics_server* m, const char* address, retention* store){
+    /**
+    * Opens the metrics endpoint and starts the thread serving it
+    *
+    * @m: server to initialize
+    * @address: "ADDR:PORT" for TCP or "unix:PATH" for a unix socket
+    * @store: retained samples exported at /range, NULL if there are none
+    *
+    * Return: false on error (a message has been printed)
+    */
+
+    memset(m, 0, sizeof(metrics_server));
+    for (int k = 0; k < METRICS_MAX_CLIENTS; k++){ m->clients[k].fd = -1; }
+    m->store = store;
+
+    if (strncmp(address, "unix:", 5) == 0){
+        m->unix_path = address + 5;
+        m->listen_fd = listenUnix(m->unix_path);
+        if (m->listen_fd == -1){
+            fprintf(stderr, "Error: failed to listen on %s. (%s)\n", m->unix_path, strerror(errno));
+            return false;
+        }
+    }
+    else {
+        m->listen_fd = listenTcp(address, METRICS_MAX_CLIENTS);
+        if (m->listen_fd == -1){ return false; }
+    }
+
+    if (!writerInit(&m->page, -1, METRICS_PAGE_CAPACITY) || !writerInit(&m->next, -1, METRICS_PAGE_CAPACITY)
+        || !writerInit(&m->body, -1, METRICS_PAGE_CAPACITY)){
+        fprintf(stderr, "Error: failed to allocate the metrics page\n");
+        return false;
+    }
+    if (pipe(m->wake) == -1){
+        fprintf(stderr, "Error: pipe creation failed. (%s)\n", strerror(errno));
+        return false;
+    }
+
+    pthread_mutex_init(&m->lock, NULL);
+    int result = pthread_create(&m->thread, NULL, metricsThread, m);
+    if (result != 0){
+        fprintf(stderr, "Error: thread creation failed. (%s)\n", strerror(result));
+        return false;
+    }
+
+    return true;
+}
+
+static void metricHeader(writer* w, const char* name, const char* type, const char* help){
+    writerString(w, "# HELP ");
+    writerString(w, name);
+    writerString(w, " ");
+    writerString(w, help);
+    writerString(w, "\n# TYPE ");
+    writerString(w, name);
+    writerString(w, " ");
+    writerString(w, type);
+    writerString(w, "\n");
+}
+
+static void gauge(writer* w, const char* name, const char* help, double value, int decimals){
+    metricHeader(w, name, "gauge", help);
+    writerString(w, name);
+    writerString(w, " ");
+    writerFixed(w, value, decimals);
+    writerString(w, "\n");
+}
+
+void metricsUpdate(metrics_server* m, const sample* s, const cpu_cores* cores, const double* core_use, const user_sessions* users, long int samples){
+    /**
+    * Renders the metrics of a sample and makes them the page served to every following scrape
+    *
+    * @m: server opened by metricsListen
+    * @s: sample, NULL if memory and cpu are not collected
+    * @cores, core_use: per-core counters and utilization, NULL if --per-cpu is not selected
+    * @users: session list, NULL if users are not collected
+    * @samples: number of samples taken so far
+    *
+    * The page is built outside the lock, including the HTTP header, then swapped with the served one.
+    * A scrape is then one memcpy of the page no matter how many scrapers there are, and never reads /proc.
+    */
+
+    const double bytes_per_gb = 1024.0 * 1024 * 1024;
+    const double ticks_per_second = sysconf(_SC_CLK_TCK);
+    writer* w = &m->body;
+    w->length = 0;
+
+    if (s != NULL){
+        gauge(w, "mysystemstats_memory_total_bytes", "Physical memory.", s->mem.total_memory * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_used_bytes", "Physical memory minus free memory.", s->mem.used_memory * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_available_bytes", "MemAvailable, memory that can be allocated without swapping.", s->mem.available * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_buffers_bytes", "Buffers.", s->mem.buffers * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_cached_bytes", "Page cache.", s->mem.cached * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_shmem_bytes", "Shared memory.", s->mem.shmem * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_dirty_bytes", "Dirty pages waiting for writeback.", s->mem.dirty * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_writeback_bytes", "Pages under writeback.", s->mem.writeback * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_memory_swap_cached_bytes", "Swap cached.", s->mem.swap_cached * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_virtual_total_bytes", "Physical memory plus swap.", s->mem.total_virtual * bytes_per_gb, 0);
+        gauge(w, "mysystemstats_virtual_used_bytes", "Used physical memory plus used swap.", s->mem.used_virtual * bytes_per_gb, 0);
+
+        const long int* ticks[CORE_FIELDS] = { &s->cpu.user, &s->cpu.nice, &s->cpu.system, &s->cpu.idle, &s->cpu.iowait,
+                                               &s->cpu.irq, &s->cpu.softirq, &s->cpu.steal, &s->cpu.guest, &s->cpu.guest_nice };
+        metricHeader(w, "mysystemstats_cpu_seconds_total", "counter", "Time spent by all cpus in each mode.");
+        for (int f = 0; f < CORE_FIELDS; f++){
+            writerString(w, "mysystemstats_cpu_seconds_total{mode=\"");
+            writerString(w, cpu_modes[f]);
+            writerString(w, "\"} ");
+            writerFixed(w, *ticks[f] / ticks_per_second, 2);
+            writerString(w, "\n");
+        }
+        gauge(w, "mysystemstats_cpu_usage_percent", "Cpu utilization since the previous sample.", s->cpu_use, 2);
+        gauge(w, "mysystemstats_procs_running", "Tasks running or waiting for a cpu.", s->cpu.procs_running, 0);
+        gauge(w, "mysystemstats_procs_blocked", "Tasks blocked on I/O.", s->cpu.procs_blocked, 0);
+    }
+
+    if (cores != NULL){
+        metricHeader(w, "mysystemstats_core_seconds_total", "counter", "Time spent by each cpu in each mode.");
+        for (int f = 0; f < CORE_FIELDS; f++){
+            for (int n = 0; n < cores->count; n++){
+                writerString(w, "mysystemstats_core_seconds_total{cpu=\"");
+                writerInteger(w, cores->id[n]);
+                writerString(w, "\",mode=\"");
+                writerString(w, cpu_modes[f]);
+                writerString(w, "\"} ");
+                writerFixed(w, cores->field[f][n] / ticks_per_second, 2);
+                writerString(w, "\n");
+            }
+        }
+        metricHeader(w, "mysystemstats_core_usage_percent", "gauge", "Utilization of each cpu since the previous sample.");
+        for (int n = 0; n < cores->count; n++){
+            writerString(w, "mysystemstats_core_usage_percent{cpu=\"");
+            writerInteger(w, cores->id[n]);
+            writerString(w, "\"} ");
+            writerFixed(w, core_use[n], 2);
+            writerString(w, "\n");
+        }
+    }
+
+    if (users != NULL){
+        gauge(w, "mysystemstats_sessions", "Logged in user sessions.", users->count, 0);
+        metricHeader(w, "mysystemstats_session_changes_total", "counter", "Samples in which the session list changed.");
+        writerString(w, "mysystemstats_session_changes_total ");
+        writerInteger(w, users->changes);
+        writerString(w, "\n");
+    }
+
+    metricHeader(w, "mysystemstats_samples_total", "counter", "Samples taken since the start.");
+    writerString(w, "mysystemstats_samples_total ");
+    writerInteger(w, samples);
+    writerString(w, "\n");
+    if (s != NULL){
+        gauge(w, "mysystemstats_last_sample_timestamp_seconds", "Wall clock time of the latest sample.", s->timestamp / 1e9, 3);
+        gauge(w, "mysystemstats_sample_interval_seconds", "Time between the latest sample and the one before it.", s->interval / 1e9, 3);
+    }
+
+    // The complete response, so a scrape only copies it
+    writer* page = &m->next;
+    page->length = 0;
+    writerString(page, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ");
+    writerInteger(page, w->length);
+    writerString(page, "\r\nConnection: close\r\n\r\n");
+    writerBytes(page, w->buffer, w->length);
+
+    pthread_mutex_lock(&m->lock);
+    writer swap = m->page; m->page = m->next; m->next = swap;
+    m->page_samples = samples;
+    pthread_mutex_unlock(&m->lock);
+}
+
+void metricsClose(metrics_server* m){
+    /**
+    * Stops the server thread, closes every connection and removes the unix socket file
+    */
+
+    close(m->wake[1]);
+    pthread_join(m->thread, NULL);
+    close(m->wake[0]);
+
+    for (int k = 0; k < METRICS_MAX_CLIENTS; k++){
+        if (m->clients[k].fd != -1){ dropClient(&m->clients[k]); }
+        free(m->clients[k].response);
+    }
+    close(m->listen_fd);
+    if (m->unix_path != NULL){ unlink(m->unix_path); }
+
+    pthread_mutex_destroy(&m->lock);
+    writerFree(&m->page);
+    writerFree(&m->next);
+    writerFree(&m->body);
+}
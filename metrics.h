@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include "output.h"
+#include "scheduler.h"
+#include "retention.h"
+
+#define METRICS_MAX_CLIENTS 64
+#define METRICS_REQUEST_SIZE 4096
+#define METRICS_CLIENT_TIMEOUT (10 * NSEC_PER_SEC)
+#define METRICS_RANGE_POINTS 120    // buckets of a /range export when the query does not ask for a number of points
+
+// One scrape in progress, the page is copied into response once the request has been read
+typedef struct metrics_client {
+
+    int fd;                     // -1 for a free slot
+    char request[METRICS_REQUEST_SIZE];
+    size_t request_length;
+    char* response;
+    size_t response_length;
+    size_t response_capacity;
+    size_t sent;
+    long long deadline;         // monotonic time the client is dropped at
+
+} metrics_client;
+
+// Endpoint serving the Prometheus text exposition of the latest sample
+typedef struct metrics_server {
+
+    int listen_fd;
+    int wake[2];                // pipe that stops the server thread
+    const char* unix_path;      // socket file removed on close, NULL for TCP
+    pthread_t thread;
+    pthread_mutex_t lock;       // guards page and page_samples
+    writer page;                // HTTP response with the metrics of the latest sample
+    writer next;                // response being built for the next sample
+    writer body;                // metrics text of the next sample
+    long int page_samples;      // number of samples the page has seen, 0 before the first one
+    retention* store;           // retained samples exported at /range, NULL without --retain
+    metrics_client clients[METRICS_MAX_CLIENTS];
+
+} metrics_server;
+
+int listenTcp(const char* address, int backlog);
+
+bool metricsListen(metrics_server* m, const char* address, retention* store);
+
+void metricsUpdate(metrics_server* m, const sample* s, const cpu_cores* cores, const double* core_use, const user_sessions* users, long int samples);
+
+void metricsClose(metrics_server* m);
+
+#endif // METRICS_H
@@ -1,219 +1,707 @@
+#include <limits.h>
 #include "stats_functions.h"
+#include "options.h"
+#include "history.h"
+#include "record.h"
+#include "output.h"
+#include "statistics.h"
+#include "processes.h"
+#include "disks.h"
+#include "network.h"
+#include "cgroup.h"
+#include "pressure.h"
+#include "profile.h"
+#include "shared.h"
+#include "metrics.h"
+#include "events.h"
+#include "agent.h"
+#include "aggregate.h"
+#include "retention.h"
+
+// Sections filled by a collector, in the order of their profile stages which start at PROFILE_MEMORY
+enum collected_section { SECTION_MEMORY, SECTION_CPU, SECTION_USERS, SECTION_CORES, SECTION_DISKS, SECTION_NETWORK, SECTION_CGROUP, SECTION_PRESSURE, SECTIONS };
+
+// State of the terminal interface, only changed between two waits of the event loop
+typedef struct ui_state {
+
+    bool quit;              // stop after the current sample
+    bool confirm;           // Ctrl-C was pressed, the answer is read from standard input while sampling goes on
+    bool redraw;            // something else wrote to the terminal, the next frame repaints the whole screen
+    bool resized;           // the terminal was resized
+    bool terminal;          // frames go to standard output, otherwise the question goes to standard error
+    bool daemon;            // there is no terminal to ask on, Ctrl-C stops at once
+
+} ui_state;
+
+static void uiWrite(const ui_state* ui, const char* text){
+    if (write(ui->terminal ? STDOUT_FILENO : STDERR_FILENO, text, strlen(text)) == -1){ perror("Error writing to terminal"); }
+}
 
-void signal_handler(int sig) {
-    char ans;
+static void handleEvent(event_loop* loop, ui_state* ui, event e){
+    /**
+    * Reacts to a signal or to standard input, between two samples or while the collectors are sampling
+    *
+    * @loop: event loop of the monitor
+    * @ui: state of the terminal interface
+    * @e: event returned by eventNext
+    *
+    * Ctrl-C asks whether to quit and the answer is read when standard input has it, so sampling keeps its cadence
+    * in the meantime and the question stays under every frame until it is answered. Ctrl-Z proceeds as normal,
+    * a resize repaints the screen and SIGTERM stops after the current sample.
+    */
 
-    // If Ctrl-Z detected it will proceed as normal
-    if (sig == SIGTSTP) { return; }
+    if (e.type == EVENT_ERROR){ ui->quit = true; }
 
-    // If Ctrl-C detected it will ask user if they want to proceed
-    if (sig == SIGINT) {
-        printf("\nCtrl-C detected: ");
-        printf("Do you want to quit? (press 'y' if yes) ");
+    if (e.type == EVENT_SIGNAL){
+        // Without a terminal to answer on Ctrl-C stops at once
+        if (e.signal == SIGTERM || (e.signal == SIGINT && (ui->daemon || !loop->input))){ ui->quit = true; }
+        else if (e.signal == SIGINT && !ui->confirm){
+            uiWrite(ui, "\nCtrl-C detected: Do you want to quit? (press 'y' if yes) ");
+            ui->confirm = true;
+            ui->redraw = true;
+        }
+        else if (e.signal == SIGWINCH){ ui->resized = true; }
+    }
+
+    if (e.type == EVENT_INPUT){
+        char answer[256];
+        ssize_t length = read(STDIN_FILENO, answer, sizeof(answer));
+        if (length <= 0){
+            // Nobody can answer anymore
+            eventInputClosed(loop);
+            if (ui->confirm){ ui->quit = true; }
+            return;
+        }
 
-        // Wait for user input
-        int ret = scanf(" %c", &ans);
-        if (ret == EOF) {
-            if (errno == EINTR) {
-                printf("\nSignal detected during scanf, resuming...\n");
-                return;
-            } 
+        // Input typed without a question is dropped, like scanf the answer is the first character that is not a space
+        for (ssize_t k = 0; k < length && ui->confirm; k++){
+            if (isspace((unsigned char) answer[k])){ continue; }
+            ui->confirm = false;
+            if (answer[k] == 'y' || answer[k] == 'Y'){ ui->quit = true; }
             else {
-                perror("scanf error");
-                exit(EXIT_FAILURE);
+                uiWrite(ui, "Resuming...\n");
+                ui->redraw = true;
             }
         }
+    }
+}
+
+static bool waitUntil(event_loop* loop, ui_state* ui, long long deadline){
+    /**
+    * Handles the signals and input that arrive until a deadline
+    *
+    * @loop: event loop of the monitor
+    * @ui: state of the terminal interface
+    * @deadline: monotonic time in nanoseconds
+    *
+    * Return: false if the monitor has to stop
+    */
+
+    while (!ui->quit){
+        event e = eventNext(loop, deadline);
+        if (e.type == EVENT_TIMEOUT){ return true; }
+        handleEvent(loop, ui, e);
+    }
+    return false;
+}
+
+static void waitCollectors(event_loop* loop, ui_state* ui, collector* running[SECTIONS], bool ready[SECTIONS], long long budget,
+                           profiler* p, long long requested){
+    /**
+    * Waits for the samples of the running collectors while handling the terminal
+    *
+    * @loop: event loop of the monitor
+    * @ui: state of the terminal interface
+    * @running: collectors that were asked for a sample, NULL for the sections that are not shown
+    * @ready: set for every collector whose sample can be read once this returns
+    * @budget: monotonic time to stop waiting at, 0 to wait for every collector
+    * @p: profiler, the wait for every collector is recorded in its stage
+    * @requested: time the samples were requested, from profileStart
+    *
+    * Only the collectors that are not ready at once are watched, so a thread's sample is usually taken without a system call.
+    * The ones still busy at the budget stay pending and are read on a later sample.
+    */
+
+    int waiting = 0;
+    for (int k = 0; k < SECTIONS; k++){
+        ready[k] = false;
+        if (running[k] == NULL){ continue; }
+
+        if (collectorArm(running[k])){
+            ready[k] = true;
+            profileEnd(p, (enum profile_stage)(PROFILE_MEMORY + k), requested);
+        }
+        else if (eventWatch(loop, collectorChannel(running[k]), k)){ waiting++; }
+    }
+
+    while (waiting > 0 && !ui->quit){
+        event e = eventNext(loop, budget);
+        if (e.type == EVENT_TIMEOUT){ break; }
+        if (e.type != EVENT_CHANNEL){
+            handleEvent(loop, ui, e);
+            continue;
+        }
 
-        if (ans == 'y' || ans == 'Y') {
-            exit(EXIT_SUCCESS);
-        } else {
-            printf("Resuming...\n");
+        // A thread's channel can still hold the signal of a sample that raced with an earlier check, it is then armed again
+        collector* c = running[e.tag];
+        collectorDisarm(c);
+        if (collectorArm(c)){
+            eventUnwatch(loop, collectorChannel(c));
+            ready[e.tag] = true;
+            profileEnd(p, (enum profile_stage)(PROFILE_MEMORY + e.tag), requested);
+            waiting--;
         }
     }
+
+    for (int k = 0; k < SECTIONS; k++){
+        if (running[k] == NULL || ready[k]){ continue; }
+        eventUnwatch(loop, collectorChannel(running[k]));
+        collectorDisarm(running[k]);
+    }
 }
 
-void display(int samples, int tdelay, bool system, bool user, bool graphics, bool sequential){
+void display(const options* opts){
     /**
     * Outputs all the system information according to the command line arguments selected by user
     * 
-    * @samples: the number of times the information will be displayed
-    * @tdelay: the time delay between each sample in seconds
-    * @system: boolean value indicating whether systems information has been selected
-    * @user: boolean value indicating whether user information has been selected
-    * @graphics: boolean value indicating whether graphics output has been selected
-    * @sequential: boolean value indicating whether equential output has been selected
+    * @opts: the command line arguments, of which
+    *   samples: the number of times the information will be displayed
+    *   interval: the time between the start of two samples in nanoseconds
+    *   adaptive_min, adaptive_max: bounds of an interval that shortens when cpu use or used memory move, 0 for a fixed interval
+    *   system: boolean value indicating whether systems information has been selected
+    *   user: boolean value indicating whether user information has been selected
+    *   graphics: boolean value indicating whether graphics output has been selected
+    *   sequential: boolean value indicating whether equential output has been selected
+    *   per_cpu: boolean value indicating whether the utilization of every core should be shown
+    *   disks: boolean value indicating whether the throughput and latency of every disk should be shown
+    *   network: boolean value indicating whether the traffic of every network interface should be shown
+    *   available: boolean value indicating whether used memory leaves out the memory the kernel can reclaim
+    *   mode: execution model of the collectors (fork per sample, persistent processes or threads)
+    *   history: number of samples kept and shown in the memory and cpu graphics sections
+    *   retain: tiers of the store rolling up the samples of a long run, shown over range and served at /range
+    *   format: text frames, or one jsonl/csv record per sample
+    *   record: file the raw samples are appended to
+    *   replay, replay_from, speed: recording shown instead of live samples, where it starts and how fast it plays
+    *   window: number of most recent samples covered by the sliding window statistics
+    *   top: number of processes shown in the top section, 0 if it is not shown
+    *   profile, profile_frames: time every stage of a sample and print the breakdown at the end, or on every frame
+    *   daemon: shared memory segment every sample is published to instead of being shown
+    *   attach: shared memory segment of a daemon the samples are read from instead of /proc
+    *   listen: address the metrics of the latest sample are served on in the Prometheus text format
+    *   agent: address of an aggregator every sample is streamed to instead of being shown
+    *   cgroup: show the memory and cpu use of a cgroup v2 against its limits, resolved into cgroup_dir by main
+    *   pressure: boolean value indicating whether the run queue, load average and pressure stall information should be shown
     * 
     * Displays header, system output, user output, cpu output, and footer
     * Graphics adds visuals to memeory and cpu usage
-    * Equential prints information in sequential manner
+    * Equential prints information in sequential manner, appending only the newest sample
+    * Otherwise every frame only rewrites the lines of the screen that changed
+    * The last frame ends with the statistics of the run, machine readable formats end with them instead
     */
 
-    // Initialize signal handler
-    struct sigaction act;
-    act.sa_handler = signal_handler;
-    act.sa_flags = 0;
-    sigemptyset(&act.sa_mask);
+    // Signals and the answer to the quit question are events of the loop that also waits for the sampling
+    // deadlines and the collectors, so no handler runs in the middle of a sample.
+    // It is created first since every thread started later has to inherit the blocked signals.
+    event_loop loop;
+    bool headless = opts->daemon != NULL || opts->agent != NULL;
+    if (!eventLoopInit(&loop, !headless)){ exit(EXIT_FAILURE); }
+    ui_state ui;
+    memset(&ui, 0, sizeof(ui));
+    ui.terminal = opts->format == FORMAT_TEXT;
+    ui.daemon = headless;
+
+    // A replay takes its samples from a recording instead of the collectors, users and cores are not recorded
+    // A client attached to a daemon takes them from its shared memory segment, with the session list
+    replay recording;
+    bool attached = opts->attach != NULL;
+    bool live = opts->replay == NULL && !attached;
+    long int replay_next = 0;
+    int samples = opts->samples;
+    if (opts->replay != NULL){
+        if (!replayOpen(&recording, opts->replay)){ exit(EXIT_FAILURE); }
+
+        // Jump to the requested start time with a binary search over the record timestamps
+        long long from = opts->replay_from;
+        if (opts->replay_relative && recording.count > 0){ from += recording.records[0].timestamp; }
+        replay_next = replaySeek(&recording, from);
+
+        long int remaining = recording.count - replay_next;
+        if (samples <= 0 || samples > remaining){ samples = remaining; }
+    }
+    bool show_system = opts->system;
+    bool show_user = opts->user && (live || attached);
+    // A daemon and an agent only publish memory, cpu and the sessions
+    bool publishing = headless;
+    bool show_cores = opts->system && opts->per_cpu && live && !publishing;
+    bool show_top = opts->top > 0 && live && !publishing;
+    bool show_disks = opts->disks && live && !publishing;
+    bool show_network = opts->network && live && !publishing;
+    bool show_cgroup = opts->cgroup != NULL && live && !publishing;
+    bool show_pressure = opts->pressure && live && !publishing;
+
+    // Interval that weighs 1 in the statistics, the shortest one of an adaptive schedule since the others are multiples of it
+    // A client attached to a daemon follows the interval of the daemon, it cannot sample more often than it publishes
+    bool adaptive = opts->adaptive_max > 0 && live;
+    long long quantum = adaptive ? opts->adaptive_min : opts->interval;
+    if (opts->replay != NULL){ quantum = recording.header->interval; }
+
+    shared_view segment;
+    if (opts->daemon != NULL && !sharedCreate(&segment, opts->daemon, quantum)){ exit(EXIT_FAILURE); }
+    if (attached && !sharedAttach(&segment, opts->attach)){ exit(EXIT_FAILURE); }
+    if (attached){ quantum = segment.segment->interval; }
+
+    // An agent streams its samples to an aggregator over a connection it keeps up on its own
+    agent_link agent;
+    if (opts->agent != NULL && !agentStart(&agent, opts->agent, quantum)){ exit(EXIT_FAILURE); }
+
+    // Samples of a long run rolled up at decreasing resolutions, all of its memory is allocated here
+    static retention store;
+    bool retaining = opts->retain != NULL && show_system;
+    if (retaining && !retentionInit(&store, opts->retain)){ exit(EXIT_FAILURE); }
+
+    // The metrics endpoint is served by its own thread from a page rebuilt once per sample
+    metrics_server metrics;
+    if (opts->listen != NULL && !metricsListen(&metrics, opts->listen, retaining ? &store : NULL)){ exit(EXIT_FAILURE); }
+
+    // Raw samples are appended to the recording file if one was given
+    int record_fd = -1;
+    if (opts->record != NULL){
+        record_fd = recordOpen(opts->record, quantum);
+        if (record_fd == -1){ exit(EXIT_FAILURE); }
+    }
 
-    if (sigaction(SIGINT, &act, NULL) == -1) {
-        perror("sigaction error for SIGINT");
+    // Initialize the sample history, previous values for cpu usage and the buffer for the session list
+    history samples_history;
+    if (!historyInit(&samples_history, opts->history)){
+        fprintf(stderr, "Error: failed to allocate a history of %d samples\n", opts->history);
         exit(EXIT_FAILURE);
     }
+    long int cpu_previous = 0, idle_previous = 0;
+    cpu_cores cores;
+    core_previous cores_previous;
+    cores_previous.count = 0;
+    double core_use[MAX_CPUS];
+    // The disk tables are large, they are kept out of the stack
+    static disk_stats disks, disks_previous;
+    static disk_rates disk_rate[MAX_DISKS];
+    disks_previous.count = 0;
+
+    // Like cpu_previous and idle_previous, the counters of the previous sample are kept for the rates
+    static network_stats network, network_previous;
+    static network_rates network_rate;
+    network_previous.count = 0;
+    cgroup_stats cgroup, cgroup_previous;
+    cgroup_rates cgroup_rate;
+    memset(&cgroup, 0, sizeof(cgroup));
+    memset(&cgroup_previous, 0, sizeof(cgroup_previous));
+    memset(&cgroup_rate, 0, sizeof(cgroup_rate));
+    pressure_stats pressure, pressure_previous;
+    pressure_rates pressure_rate;
+    memset(&pressure, 0, sizeof(pressure));
+    memset(&pressure_previous, 0, sizeof(pressure_previous));
+    memset(&pressure_rate, 0, sizeof(pressure_rate));
+    user_sessions users;
+    memset(&users, 0, sizeof(users));
+
+    // Values of the last sample whose collectors answered in time, shown again for a collector that is late
+    sample last_system;
+    memset(&last_system, 0, sizeof(last_system));
+    long int late_samples = 0;
+
+    // Streaming statistics of memory and cpu over the whole run and the sliding window
+    run_statistics stats;
+    if (!statisticsInit(&stats, opts->window, opts->available, quantum)){
+        fprintf(stderr, "Error: failed to allocate a window of %d samples\n", opts->window);
+        exit(EXIT_FAILURE);
+    }
+
+    // Renderer that keeps track of what is on screen
+    renderer screen;
+    rendererInit(&screen, opts->sequential);
 
-    if (sigaction(SIGTSTP, &act, NULL) == -1) {
-        perror("sigaction error for SIGTSTP");
+    // Writer of the jsonl or csv records, a replay is written in batches and the other runs at their sampling interval
+    sample_output records;
+    if (opts->format != FORMAT_TEXT && !outputInit(&records, opts->format, STDOUT_FILENO, show_system, show_user, opts->replay == NULL ? quantum : 0)){
+        fprintf(stderr, "Error: failed to allocate the output buffer\n");
         exit(EXIT_FAILURE);
     }
 
+    // Rows reserved under the memory and cpu graphics sections so the layout does not move while the history fills up
+    int reserved_rows = samples < opts->history ? samples : opts->history;
 
-    // Initialize variables for terminal and cpu output, aswell as previous values for memeory and cpu usage
-    char terminal_memory_output[1024][1024];
-    char CPU_output[1024][1024];
-    double memory_previous;
-    long int cpu_previous = 0, idle_previous = 0;
+    // Latency of every stage and cpu time of the monitor, each probe is a single branch when disabled
+    profiler profile;
+    profilerInit(&profile, opts->profile, opts->profile_frames);
 
-    // Create Pipes
-    int pipefd_memory[2], pipefd_cpu[2], pipefd_user[2];
+    // Start the collectors once, persistent workers are reused for every sample
+    long long stage_start = profileStart(&profile);
+    collector memory_collector, cpu_collector, user_collector, core_collector, disk_collector, network_collector, cgroup_collector, pressure_collector;
+    if (show_system && live){
+        startCollector(&memory_collector, opts->mode, memoryStats);
+        startCollector(&cpu_collector, opts->mode, cpuStats);
+    }
+    if (show_user && live){ startCollector(&user_collector, opts->mode, userOutput); }
+    if (show_cores){ startCollector(&core_collector, opts->mode, coreStats); }
+    if (show_disks){ startCollector(&disk_collector, opts->mode, diskStats); }
+    if (show_network){ startCollector(&network_collector, opts->mode, networkStats); }
+    if (show_cgroup){ startCollector(&cgroup_collector, opts->mode, cgroupStats); }
+    if (show_pressure){ startCollector(&pressure_collector, opts->mode, pressureStats); }
+    profileEnd(&profile, PROFILE_SPAWN, stage_start);
+
+    // The same collectors by section, for the wait on their channels
+    collector* running[SECTIONS] = { NULL };
+    bool ready[SECTIONS] = { false };
+    if (show_system && live){
+        running[SECTION_MEMORY] = &memory_collector;
+        running[SECTION_CPU] = &cpu_collector;
+    }
+    if (show_user && live){ running[SECTION_USERS] = &user_collector; }
+    if (show_cores){ running[SECTION_CORES] = &core_collector; }
+    if (show_disks){ running[SECTION_DISKS] = &disk_collector; }
+    if (show_network){ running[SECTION_NETWORK] = &network_collector; }
+    if (show_cgroup){ running[SECTION_CGROUP] = &cgroup_collector; }
+    if (show_pressure){ running[SECTION_PRESSURE] = &pressure_collector; }
+
+    // The process scan runs on its own threads in the monitor since it keeps the previous ticks of every pid
+    process_sampler top;
+    if (show_top && !processSamplerInit(&top, opts->top)){ exit(EXIT_FAILURE); }
+
+    // Samples are taken on absolute deadlines so that they stay evenly spaced
+    scheduler schedule;
+    schedulerStart(&schedule, attached ? quantum : opts->interval);
+    if (adaptive){ schedulerAdaptive(&schedule, opts->adaptive_min, opts->adaptive_max); }
+    long long previous_timestamp = 0;
+    int last_published = 0;     // publications of the daemon already read, none at first
+    double adaptive_cpu = 0, adaptive_used = 0;
+
+    long long replay_start = monotonicNow();
+
+    // Loop samples number of times, every wait below also handles the terminal
+    for (int i = 0; i < samples && !ui.quit; i++){
+
+        // Store the numeric results of this sample in the history
+        sample* current = historyAppend(&samples_history);
+        long long sample_start = 0, requested = 0, budget = 0;
+
+        if (attached){
+            // Wait for this sample's deadline, then copy the latest snapshot of the daemon.
+            // A snapshot that was already read is not a new sample, the client waits until the daemon publishes the next one.
+            if (i > 0){
+                schedulerAdvance(&schedule);
+                if (!waitUntil(&loop, &ui, schedule.next)){ break; }
+            }
+            int published;
+            while ((published = sharedRead(&segment, current, &users)) == last_published && waitUntil(&loop, &ui, monotonicNow() + 10 * NSEC_PER_MSEC)){ }
+            if (ui.quit){ break; }
+            if (published == -1){
+                fprintf(stderr, "Error: the daemon publishing to %s has stopped\n", opts->attach);
+                break;
+            }
+            last_published = published;
+        }
+        else if (!live){
+            // Replay the next record at its recorded pace scaled by the speed, or immediately with speed 0
+            const record* r = &recording.records[replay_next + i];
+            if (i > 0 && opts->speed > 0
+                && !waitUntil(&loop, &ui, replay_start + (long long)((r->timestamp - recording.records[replay_next].timestamp) / opts->speed))){ break; }
+            current->timestamp = r->timestamp;
+            current->interval = r->interval;
+            current->mem = r->mem;
+            current->cpu = r->cpu;
+            current->cpu_use = cpuUsage(current->cpu, &cpu_previous, &idle_previous);
+        }
+        else {
+            // Wait for the deadline of this sample on the timer of the loop, the first one is taken immediately
+            if (i > 0){
+                schedulerAdvance(&schedule);
+                if (!waitUntil(&loop, &ui, schedule.next)){ break; }
+            }
+            sample_start = profileStart(&profile);
 
-    // Initialize the cpu information with -1 iteration
-    // CPUOutput(CPU_output, graphics, -1, &cpu_previous, &idle_previous);
+            // Trigger every collector first so that they sample concurrently
+            if (show_system){
+                requestSample(&memory_collector);
+                requestSample(&cpu_collector);
+            }
+            if (show_user && live){ requestSample(&user_collector); }
+            if (show_cores){ requestSample(&core_collector); }
+            if (show_disks){ requestSample(&disk_collector); }
+            if (show_network){ requestSample(&network_collector); }
+            if (show_cgroup){ requestSample(&cgroup_collector); }
+            if (show_pressure){ requestSample(&pressure_collector); }
+            profileEnd(&profile, PROFILE_SPAWN, sample_start);
+            requested = profileStart(&profile);
+
+            // The first sample waits for every collector, later ones only until half an interval after the request.
+            // A collector that is still busy then keeps its previous values on screen and is read on a later frame.
+            // Back to back samples with no interval wait for every collector.
+            if (i > 0 && schedule.interval > 0){ budget = monotonicNow() + schedule.interval / 2; }
+
+            current->timestamp = realtimeNow();
+
+            // Scan the processes while the collectors are sampling
+            if (show_top){
+                stage_start = profileStart(&profile);
+                processSample(&top);
+                profileEnd(&profile, PROFILE_TOP, stage_start);
+            }
 
+            waitCollectors(&loop, &ui, running, ready, budget, &profile, requested);
+        }
 
+        // Effective spacing of the samples, a replay has the one that was recorded
+        if (live || attached){ current->interval = previous_timestamp > 0 && current->timestamp > previous_timestamp ? current->timestamp - previous_timestamp : 0; }
+        previous_timestamp = current->timestamp;
 
-    // Loop samples number of times
-    for (int i = 0; i < samples; i++){
+        bool system_late = false, cores_late = false, disks_late = false, network_late = false, cgroup_late = false, pressure_late = false;
 
-        // Create the pipes
-        if (pipe(pipefd_memory) == -1 || pipe(pipefd_cpu) == -1 || pipe(pipefd_user) == -1) {
-            fprintf(stderr, "Error: pipe creation failed. (%s)\n", strerror(errno));
-            exit(1);
+        if (show_system && live){
+            // Read system data from the collectors
+            if (ready[SECTION_MEMORY]){
+                stage_start = profileStart(&profile);
+                if (collectorRead(&memory_collector, &current->mem, sizeof(current->mem)) != sizeof(current->mem)) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&memory_collector);
+            }
+            else { current->mem = last_system.mem; system_late = true; }
+
+            if (ready[SECTION_CPU]){
+                stage_start = profileStart(&profile);
+                if (collectorRead(&cpu_collector, &current->cpu, sizeof(current->cpu)) != sizeof(current->cpu)) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&cpu_collector);
+                current->cpu_use = cpuUsage(current->cpu, &cpu_previous, &idle_previous);
+            }
+            else {
+                current->cpu = last_system.cpu;
+                current->cpu_use = last_system.cpu_use;
+                system_late = true;
+            }
+
+            last_system = *current;
         }
 
-        pid_t pid_memory = fork();
+        // An adaptive schedule follows a sample that moved the cpu use or the used memory closely, and backs off while they stay put
+        // The cpu use of the first sample is the average since boot, the comparison starts with the third one
+        if (adaptive && (!show_system || i > 1)){
+            double used = opts->available ? current->mem.used_available : current->mem.used_memory;
+            schedulerAdapt(&schedule, show_system && !system_late && (fabs(current->cpu_use - adaptive_cpu) > ADAPTIVE_CPU_THRESHOLD
+                                                                     || fabs(used - adaptive_used) > ADAPTIVE_MEMORY_THRESHOLD * current->mem.total_memory));
+        }
+        if (show_system){
+            adaptive_cpu = current->cpu_use;
+            adaptive_used = opts->available ? current->mem.used_available : current->mem.used_memory;
+        }
 
-        if (pid_memory == -1) {
-            fprintf(stderr, "Error: fork failed. (%s)\n", strerror(errno));
-            exit(1);
+        // A late sample holds the values of the previous one, a replay would count them twice
+        if (record_fd != -1 && !system_late && !recordAppend(record_fd, current)){ perror("Error writing to recording"); }
+
+        if (show_user && live && ready[SECTION_USERS]){
+            // The session list is only sent again when it changed, otherwise the previous one is kept
+            stage_start = profileStart(&profile);
+            if (readUsers(&user_collector, &users) == -1) { perror("Error reading from collector"); }
+            profileEnd(&profile, PROFILE_PIPE, stage_start);
+            finishSample(&user_collector);
         }
-        else if (pid_memory == 0) {
-            // Child process
-            close(pipefd_memory[0]); // Close unused read 
-            close(pipefd_cpu[0]); close(pipefd_cpu[1]); close(pipefd_user[0]); close(pipefd_user[1]); 
-            dup2(pipefd_memory[1], STDOUT_FILENO); // Redirect stdout to the pipe
-            
-            // Memory
-            memoryStats(pipefd_memory);
-            exit(0);
-        } 
-        else {
 
-            pid_t pid_users = fork();
+        if (show_cores){
+            if (ready[SECTION_CORES]){
+                stage_start = profileStart(&profile);
+                if (readCores(&core_collector, &cores) == -1) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&core_collector);
+                coreDeltas(&cores, &cores_previous, core_use);
+            }
+            else { cores_late = true; }
+        }
 
-            if (pid_users == -1) {
-                fprintf(stderr, "Error: fork failed. (%s)\n", strerror(errno));
-                exit(1);
+        if (show_disks){
+            if (ready[SECTION_DISKS]){
+                stage_start = profileStart(&profile);
+                if (readDisks(&disk_collector, &disks) == -1) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&disk_collector);
+                diskDeltas(&disks, &disks_previous, disk_rate);
             }
-            else if (pid_users == 0) {
-                // Child process
-                close(pipefd_user[0]); // Close unused read 
-                close(pipefd_memory[0]); close(pipefd_memory[1]); close(pipefd_cpu[0]); close(pipefd_cpu[1]); 
-                // User
-                userOutput(pipefd_user);
-                close(pipefd_user[1]); // Close unused write end
-                exit(0);
-            } 
-            else {
+            else { disks_late = true; }
+        }
 
-                pid_t pid_cpu = fork();
-
-                if (pid_cpu == -1) {
-                    fprintf(stderr, "Error: fork failed. (%s)\n", strerror(errno));
-                    exit(1);
-                }
-                else if (pid_cpu == 0) {
-                    // Child process
-                    close(pipefd_cpu[0]); // Close unused read 
-                    close(pipefd_memory[0]); close(pipefd_memory[1]); close(pipefd_user[0]); close(pipefd_user[1]); 
-                    dup2(pipefd_cpu[1], STDOUT_FILENO); // Redirect stdout to the pipe
-                    // Cpu
-                    cpuStats(pipefd_cpu);
-                    close(pipefd_cpu[1]); // Close unused write end
-                    exit(0);
-                }
-                else{
-                    
-                    // Main partent Process
-                    // Close the write end of the pipe for the parent
-                    close(pipefd_cpu[1]); close(pipefd_memory[1]); close(pipefd_user[1]);
-                    // Wait for all child processes to finish
-                    waitpid(pid_memory, NULL, 0);
-                    waitpid(pid_users, NULL, 0);
-                    waitpid(pid_cpu, NULL, 0);
-
-                
-                    // If sequential is selected then we do not reset terminal between iterations and state iteration number
-                    if (!sequential){ printf("\033[2J \033[1;1H\n"); }
-                    else { printf(">>> iteration %d\n", i); }
-
-                    // Displays header information
-                    headerUsage(samples, tdelay);
-
-                    // If system is slected diplays systems information usinf systemOutput function
-                    if (system){
-                        // Read system data from the pipe
-                        memory received_info;
-                        ssize_t bytes_read = read(pipefd_memory[0], &received_info, sizeof(received_info));
-
-                        if (bytes_read == -1) { perror("Error reading from pipe"); }
-
-                        systemOutput(terminal_memory_output, graphics, i, &memory_previous, received_info);
-                        for (int j = 0; j < samples - i - 1; j++){ printf("\n"); }
-
-                        // Close Pipe after reading
-                        close(pipefd_memory[0]);
-                    }
-                    
-                    // If user is slected diplays user information usinf userOutput function
-                    if (user){ 
-                        // Read User data from pipe
-                        // Read user information from the pipe
-                        char buffer[1024];
-                        int bytesRead;
-
-                        // Print Divider
-                        printf("--------------------------------------------\n");
-                        printf("### Sessions/users ###\n");
-
-                        while ((bytesRead = read(pipefd_user[0], buffer, sizeof(buffer) - 1)) > 0) {
-                            buffer[bytesRead] = '\0';
-                            printf("%s", buffer);
-                        }
-                        close(pipefd_user[0]); // Close read end after reading
-                     }
-
-                    // Displays cpu information using CPUOutput function is system is selected
-                    if (system){ 
-                        // Read system data from the pipe
-                        cpu_stats received_info;
-                        ssize_t bytes_read = read(pipefd_cpu[0], &received_info, sizeof(received_info));
-
-                        if (bytes_read == -1) { perror("Error reading from pipe"); }
-
-                        CPUOutput(CPU_output, graphics, i, &cpu_previous, &idle_previous, received_info); 
-
-                        // Close Pipe after reading
-                        close(pipefd_cpu[0]);
-                        }
-
-                    // Delay the output for tdelay seconds
-                    sleep(tdelay);
-
-                    // Displays footer
-                    footerUsage();
-
-                }
+        if (show_network){
+            if (ready[SECTION_NETWORK]){
+                stage_start = profileStart(&profile);
+                if (readInterfaces(&network_collector, &network) == -1) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&network_collector);
+                networkDeltas(&network, &network_previous, &network_rate);
             }
+            else { network_late = true; }
         }
+
+        if (show_cgroup){
+            if (ready[SECTION_CGROUP]){
+                stage_start = profileStart(&profile);
+                if (collectorRead(&cgroup_collector, &cgroup, sizeof(cgroup)) != sizeof(cgroup)) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&cgroup_collector);
+                cgroupDeltas(&cgroup, &cgroup_previous, &cgroup_rate);
+            }
+            else { cgroup_late = true; }
+        }
+
+        if (show_pressure){
+            if (ready[SECTION_PRESSURE]){
+                stage_start = profileStart(&profile);
+                if (collectorRead(&pressure_collector, &pressure, sizeof(pressure)) != sizeof(pressure)) { perror("Error reading from collector"); }
+                profileEnd(&profile, PROFILE_PIPE, stage_start);
+                finishSample(&pressure_collector);
+                pressureDeltas(&pressure, &pressure_previous, &pressure_rate);
+            }
+            else { pressure_late = true; }
+        }
+
+        // Stale values are shown but not counted twice in the statistics
+        if (system_late || cores_late || disks_late || network_late || cgroup_late || pressure_late){ late_samples++; }
+        statisticsAdd(&stats, current->interval, show_system && !system_late ? current : NULL, show_cores && !cores_late ? &cores : NULL, show_cores && !cores_late ? core_use : NULL);
+        if (retaining && !system_late){ retentionAdd(&store, current); }
+
+        if (opts->listen != NULL){
+            metricsUpdate(&metrics, show_system ? current : NULL, show_cores ? &cores : NULL, show_cores ? core_use : NULL,
+                          show_user ? &users : NULL, i + 1);
+        }
+
+        // A daemon publishes the sample to its clients and an agent to its aggregator instead of showing it
+        if (opts->daemon != NULL){ sharedPublish(&segment, current, show_user ? &users : NULL); }
+        if (opts->agent != NULL){ agentSend(&agent, current, show_user ? &users : NULL); }
+        if (publishing){ continue; }
+
+        // Machine readable formats write one record per sample instead of a frame
+        if (opts->format != FORMAT_TEXT){
+            stage_start = profileStart(&profile);
+            outputSample(&records, current, show_cores ? &cores : NULL, show_cores ? core_use : NULL, users.count, show_top ? &top : NULL,
+                         show_disks ? &disks : NULL, show_disks ? disk_rate : NULL,
+                         show_network ? &network : NULL, show_network ? &network_rate : NULL,
+                         show_cgroup ? &cgroup : NULL, show_cgroup ? &cgroup_rate : NULL,
+                         show_pressure ? &pressure : NULL, show_pressure ? &pressure_rate : NULL);
+            profileEnd(&profile, PROFILE_OUTPUT, stage_start);
+            if (live){ profileEnd(&profile, PROFILE_SAMPLE, sample_start); }
+            continue;
+        }
+
+        // Build the frame of this sample, the renderer only sends what changed since the last one
+        if (ui.resized){ rendererResize(&screen); ui.resized = false; }
+        if (ui.redraw){ rendererInvalidate(&screen); ui.redraw = false; }
+        stage_start = profileStart(&profile);
+        frame* f = frameBegin(&screen);
+
+        // If sequential is selected then the frames are appended and state the iteration number
+        if (opts->sequential){ framePrintf(f, ">>> iteration %d\n", i); }
+
+        // Displays header information
+        headerUsage(f, samples, (double) schedule.interval / NSEC_PER_SEC);
+        if (schedule.missed > 0){ framePrintf(f, "Missed deadlines: %ld\n", schedule.missed); }
+        if (late_samples > 0){ framePrintf(f, "Late samples: %ld\n", late_samples); }
+
+        // If system is slected diplays systems information usinf systemOutput function
+        if (show_system){
+            systemOutput(f, &samples_history, opts->graphics, opts->sequential, opts->available);
+            if (!opts->sequential){
+                for (int j = samples_history.count; j < reserved_rows; j++){ framePrintf(f, "\n"); }
+            }
+        }
+        
+        // If user is slected diplays the session list read from the user collector
+        if (show_user){ 
+            // Print Divider
+            framePrintf(f, "--------------------------------------------\n");
+            framePrintf(f, "### Sessions/users ###\n");
+            if (users.text != NULL){ framePrintf(f, "%s", users.text); }
+            if (users.events != NULL && users.events[0] != '\0'){ framePrintf(f, " Last session changes:\n%s", users.events); }
+        }
+
+        // Displays cpu information using CPUOutput function is system is selected
+        if (show_system){
+            CPUOutput(f, &samples_history, opts->graphics, opts->sequential);
+            if (opts->graphics && !opts->sequential){
+                for (int j = samples_history.count; j < reserved_rows; j++){ framePrintf(f, "\n"); }
+            }
+        }
+
+        // Displays the memory and cpu of the cgroup against its limits if cgroup is selected
+        if (show_cgroup){ cgroupOutput(f, opts->graphics, &cgroup, &cgroup_rate); }
+
+        // Displays the run queue and the time tasks waited for cpu, memory and io if pressure is selected
+        if (show_pressure){ pressureOutput(f, opts->graphics, &pressure, &pressure_rate, show_system ? &current->cpu : NULL); }
+
+        // Displays the rollups of the retained samples over the range if retain is selected
+        if (retaining){ retentionOutput(f, &store, opts->range, opts->available); }
+
+        // Displays the utilization of every core if per-cpu is selected
+        if (show_cores){ coreOutput(f, opts->graphics, &cores, core_use); }
+
+        // Displays the processes using the most cpu if top is selected
+        if (show_top){ topOutput(f, &top); }
+
+        // Displays the throughput and latency of every disk if disks is selected
+        if (show_disks){ diskOutput(f, opts->graphics, &disks, disk_rate); }
+
+        // Displays the traffic of every network interface if network is selected
+        if (show_network){ networkOutput(f, &network, &network_rate); }
+
+        // The last frame also shows the statistics of the whole run
+        if (show_system && i == samples - 1){ statisticsOutput(f, &stats); }
+
+        // The profile of the stages so far, on every frame or with the last one
+        if (profile.enabled && (profile.every_frame || i == samples - 1)){ profileOutput(f, &profile); }
+
+        // Displays footer
+        footerUsage(f, opts->replay != NULL ? &recording.header->host : NULL);
+
+        // The quit question stays on screen while sampling goes on
+        if (ui.confirm){ framePrintf(f, "Ctrl-C detected: Do you want to quit? (press 'y' if yes)\n"); }
+        profileEnd(&profile, PROFILE_RENDER, stage_start);
+
+        stage_start = profileStart(&profile);
+        frameFlush(&screen);
+        profileEnd(&profile, PROFILE_FLUSH, stage_start);
+        if (live){ profileEnd(&profile, PROFILE_SAMPLE, sample_start); }
     }
+
+    // Machine readable formats end with the statistics, as a jsonl record or as text on standard error for csv
+    if (show_system && opts->format == FORMAT_JSONL){ outputSummary(&records, &stats); }
+    if (opts->format != FORMAT_TEXT && ((show_system && opts->format == FORMAT_CSV) || profile.enabled)){
+        frame* f = frameBegin(&screen);
+        if (show_system && opts->format == FORMAT_CSV){ statisticsOutput(f, &stats); }
+        if (profile.enabled){ profileOutput(f, &profile); }
+        writerFlush(&records.out);
+        if (write(STDERR_FILENO, f->text, f->length) == -1){ perror("Error writing summary"); }
+    }
+
+    // Shut down the persistent workers
+    if (show_system && live){
+        stopCollector(&memory_collector);
+        stopCollector(&cpu_collector);
+    }
+    if (show_user && live){ stopCollector(&user_collector); }
+    if (show_cores){ stopCollector(&core_collector); }
+    if (show_disks){ stopCollector(&disk_collector); }
+    if (show_network){ stopCollector(&network_collector); }
+    if (show_cgroup){ stopCollector(&cgroup_collector); }
+    if (show_pressure){ stopCollector(&pressure_collector); }
+    if (show_top){ processSamplerFree(&top); }
+
+    historyFree(&samples_history);
+    statisticsFree(&stats);
+    rendererFree(&screen);
+    if (opts->format != FORMAT_TEXT){ outputFree(&records); }
+    free(users.text);
+    free(users.events);
+    if (record_fd != -1){ close(record_fd); }
+    if (opts->replay != NULL){ replayClose(&recording); }
+    if (opts->daemon != NULL || attached){ sharedClose(&segment); }
+    if (opts->agent != NULL){ agentStop(&agent); }
+    if (opts->listen != NULL){ metricsClose(&metrics); }
+    if (retaining){ retentionFree(&store); }
+    eventLoopClose(&loop);
 }
 
 int main(int argc, char *argv[]){
@@ -227,8 +715,16 @@ int main(int argc, char *argv[]){
     */
 
     // Default values if not specified
-    int samples = 10; int tdelay = 1;
-    bool system = true; bool user = true; bool graphics = false; bool sequential = false;
+    options opts;
+    opts.samples = 10; opts.interval = NSEC_PER_SEC; opts.adaptive_min = 0; opts.adaptive_max = 0;
+    opts.system = true; opts.user = true; opts.graphics = false; opts.sequential = false; opts.per_cpu = false; opts.disks = false; opts.network = false; opts.pressure = false; opts.available = false;
+    opts.mode = MODE_PROCESS; opts.history = DEFAULT_HISTORY; opts.retain = NULL; opts.range = 0;
+    opts.format = FORMAT_TEXT; opts.window = DEFAULT_WINDOW; opts.top = 0;
+    opts.profile = false; opts.profile_frames = false;
+    opts.daemon = NULL; opts.attach = NULL; opts.listen = NULL; opts.cgroup = NULL;
+    opts.agent = NULL; opts.aggregate = NULL;
+    opts.record = NULL; opts.replay = NULL; opts.replay_from = 0; opts.replay_relative = false; opts.speed = 1;
+    int tdelay;
 
     // boolean values to check if arguments have been seen previously
     bool found = false;
@@ -237,38 +733,176 @@ int main(int argc, char *argv[]){
     // Parse command line arguments
     for (int i = 1; i < argc; i++){
         if (strcmp(argv[i], "--system") == 0 || strcmp(argv[i], "-s") == 0){
-            system = true; system_specified = true;
-            if (!user_specified){ user = false; }
+            opts.system = true; system_specified = true;
+            if (!user_specified){ opts.user = false; }
         }
         else if (strcmp(argv[i], "--user") == 0 || strcmp(argv[i], "-u") == 0){
-            user = true; user_specified = true;
-            if (!system_specified){ system = false; }
+            opts.user = true; user_specified = true;
+            if (!system_specified){ opts.system = false; }
         }
         else if (strcmp(argv[i], "--graphics") == 0 || strcmp(argv[i], "-g") == 0){
-            graphics = true;
+            opts.graphics = true;
         }
         else if (strcmp(argv[i], "--sequential") == 0 || strcmp(argv[i], "-seq") == 0){
-            sequential = true;
+            opts.sequential = true;
+        }
+        else if (strcmp(argv[i], "--per-cpu") == 0){
+            opts.per_cpu = true;
+        }
+        else if (strcmp(argv[i], "--disks") == 0){
+            opts.disks = true;
+        }
+        else if (strcmp(argv[i], "--network") == 0){
+            opts.network = true;
+        }
+        else if (strcmp(argv[i], "--pressure") == 0){
+            opts.pressure = true;
+        }
+        else if (strcmp(argv[i], "--available") == 0){
+            opts.available = true;
         }
         else if (strncmp(argv[i], "--samples=", 10) == 0){
             // Gets integer in string, and sets found to true to indicate that samples have been seen
-            sscanf(argv[i] + 10, "%d", &samples);
+            sscanf(argv[i] + 10, "%d", &opts.samples);
             found = true;
         }
         else if (strncmp(argv[i], "--tdelay=", 9) == 0){
-            sscanf(argv[i] + 9, "%d", &tdelay);
+            if (sscanf(argv[i] + 9, "%d", &tdelay) == 1){ opts.interval = tdelay * NSEC_PER_SEC; }
+        }
+        else if (strncmp(argv[i], "--interval=", 11) == 0){
+            if (!parseInterval(argv[i] + 11, &opts.interval)){
+                fprintf(stderr, "Error: invalid interval '%s', expected a value such as 250ms or 2s\n", argv[i] + 11);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--adaptive=", 11) == 0){
+            if (!parseIntervalRange(argv[i] + 11, &opts.adaptive_min, &opts.adaptive_max)){
+                fprintf(stderr, "Error: invalid adaptive interval '%s', expected MIN..MAX such as 100ms..5s\n", argv[i] + 11);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--history=", 10) == 0){
+            if (sscanf(argv[i] + 10, "%d", &opts.history) != 1 || opts.history <= 0){
+                fprintf(stderr, "Error: invalid history size '%s'\n", argv[i] + 10);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--retain") == 0 || strncmp(argv[i], "--retain=", 9) == 0){
+            opts.retain = argv[i][8] == '=' ? argv[i] + 9 : RETENTION_DEFAULT;
+        }
+        else if (strncmp(argv[i], "--range=", 8) == 0){
+            if (!parseInterval(argv[i] + 8, &opts.range)){
+                fprintf(stderr, "Error: invalid range '%s', expected a duration such as 30m or 6h\n", argv[i] + 8);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--window=", 9) == 0){
+            if (sscanf(argv[i] + 9, "%d", &opts.window) != 1 || opts.window <= 0){
+                fprintf(stderr, "Error: invalid window size '%s'\n", argv[i] + 9);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--top=", 6) == 0){
+            if (sscanf(argv[i] + 6, "%d", &opts.top) != 1 || opts.top < 0){
+                fprintf(stderr, "Error: invalid number of processes '%s'\n", argv[i] + 6);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--self-profile") == 0 || strcmp(argv[i], "--self-profile=exit") == 0){
+            opts.profile = true;
+        }
+        else if (strcmp(argv[i], "--self-profile=frame") == 0){
+            opts.profile = true; opts.profile_frames = true;
+        }
+        else if (strncmp(argv[i], "--format=", 9) == 0){
+            if (!parseFormat(argv[i] + 9, &opts.format)){
+                fprintf(stderr, "Error: unknown format '%s', expected text, jsonl or csv\n", argv[i] + 9);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--daemon") == 0 || strncmp(argv[i], "--daemon=", 9) == 0){
+            opts.daemon = argv[i][8] == '=' ? argv[i] + 9 : SHARED_DEFAULT_NAME;
+        }
+        else if (strcmp(argv[i], "--attach") == 0 || strncmp(argv[i], "--attach=", 9) == 0){
+            opts.attach = argv[i][8] == '=' ? argv[i] + 9 : SHARED_DEFAULT_NAME;
+        }
+        else if (strcmp(argv[i], "--cgroup") == 0 || strncmp(argv[i], "--cgroup=", 9) == 0){
+            opts.cgroup = argv[i][8] == '=' ? argv[i] + 9 : "";
+        }
+        else if (strncmp(argv[i], "--listen=", 9) == 0){
+            opts.listen = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--agent=", 8) == 0){
+            opts.agent = argv[i] + 8;
+        }
+        else if (strncmp(argv[i], "--aggregate=", 12) == 0){
+            opts.aggregate = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--proc-root=", 12) == 0){
+            // Read by the collectors, which inherit it when they are started
+            proc_root = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--utmp=", 7) == 0){
+            utmp_path = argv[i] + 7;
+        }
+        else if (strncmp(argv[i], "--record=", 9) == 0){
+            opts.record = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--replay=", 9) == 0){
+            opts.replay = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--replay-from=", 14) == 0){
+            // Seconds since the epoch, or seconds after the first record when prefixed with '+'
+            const char* from = argv[i] + 14;
+            opts.replay_relative = (*from == '+');
+            opts.replay_from = (long long)(atof(from + opts.replay_relative) * NSEC_PER_SEC);
+        }
+        else if (strncmp(argv[i], "--speed=", 8) == 0){
+            if (sscanf(argv[i] + 8, "%lf", &opts.speed) != 1 || opts.speed < 0){
+                fprintf(stderr, "Error: invalid replay speed '%s'\n", argv[i] + 8);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--mode=", 7) == 0){
+            if (!parseExecMode(argv[i] + 7, &opts.mode)){
+                fprintf(stderr, "Error: unknown mode '%s', expected fork, process or thread\n", argv[i] + 7);
+                return 1;
+            }
         }
         // If integer is passed as command line argument the first is samples and the second is delay
         else if (isdigit(*argv[i])){
             if (!found){
-                samples = atoi(argv[i]);
+                opts.samples = atoi(argv[i]);
                 found = true;
             }
-            else{ tdelay = atoi(argv[i]); }
+            else{ opts.interval = atoi(argv[i]) * NSEC_PER_SEC; }
         }
     }
 
-    display(samples, tdelay, system, user, graphics, sequential);
+    // A replay shows the whole recording unless a number of samples was given
+    if (opts.replay != NULL && !found){ opts.samples = 0; }
+
+    // A daemon, an agent and an aggregator keep running until they are stopped unless a number of samples was given
+    if ((opts.daemon != NULL || opts.agent != NULL || opts.aggregate != NULL) && !found){ opts.samples = INT_MAX; }
+    if ((opts.daemon != NULL) + (opts.attach != NULL) + (opts.replay != NULL) > 1){
+        fprintf(stderr, "Error: --daemon, --attach and --replay cannot be combined\n");
+        return 1;
+    }
+    if (opts.aggregate != NULL && (opts.daemon != NULL || opts.attach != NULL || opts.replay != NULL || opts.agent != NULL)){
+        fprintf(stderr, "Error: --aggregate does not sample this host and cannot be combined with --daemon, --attach, --replay or --agent\n");
+        return 1;
+    }
+
+    // The aggregator only receives the samples of its agents
+    if (opts.aggregate != NULL){
+        aggregate(&opts);
+        return 0;
+    }
+
+    // The collector reads the directory, which has to be known before it starts
+    if (opts.cgroup != NULL && !cgroupResolve(opts.cgroup[0] != '\0' ? opts.cgroup : NULL)){ return 1; }
+
+    display(&opts);
 
     return 0;
 
@@ -1,15 +1,23 @@
 #CC : compiler
 CC = gcc
 #compiler flags
-CFLAGS = -Wall -g -Werror
+CFLAGS = -Wall -g -O3 -Werror -pthread
 
 ## All: run the prog target
 .PHONY: all
 all: mySystemStats
 
 ## prog: link the object files to make the executable
-mySystemStats: mySystemStats.o stats_functions.o
-	$(CC) $(CFLAGS) -o $@ $^
+mySystemStats: mySystemStats.o stats_functions.o collectors.o ring.o procfs.o scheduler.o history.o render.o record.o output.o statistics.o processes.o disks.o network.o profile.o shared.o metrics.o events.o cgroup.o pressure.o agent.o aggregate.o retention.o
+	$(CC) $(CFLAGS) -o $@ $^ -lm
+
+## bench: build and run the /proc/stat microbenchmark and the collector and renderer benchmark on synthetic fixtures
+.PHONY: bench
+bench: mySystemStatsBench
+	./mySystemStatsBench
+
+mySystemStatsBench: bench.o fixtures.o procfs.o stats_functions.o collectors.o ring.o history.o render.o scheduler.o
+	$(CC) $(CFLAGS) -o $@ $^ -lm
 
 ## %.o compiles C files into object files 
 %.o: %.c
@@ -19,7 +27,7 @@ mySystemStats: mySystemStats.o stats_functions.o
 .PHONY: clean
 clean:
 	rm -f *.o
-	rm -f mySystemStats
+	rm -f mySystemStats mySystemStatsBench
 
 ## help: display this help message
 .PHONY: help
@@ -0,0 +1,186 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include "network.h"
+#include "collectors.h"
+#include "scheduler.h"
+
+#define NAME_INDEX 8192         // power of two above MAX_INTERFACES
+
+// Positions of the used fields among the 16 numbers of a /proc/net/dev line
+static const int net_columns[NET_FIELDS] = { 0, 1, 2, 3, 8, 9, 10, 11 };
+
+void networkStats(int pipefd[2]){
+    /**
+    * Reads the counters of every interface from /proc/net/dev and writes them to the pipe
+    *
+    * @pipefd: pipe whose write end receives the size of the sample followed by the counters of each interface
+    *
+    * The file is parsed in a single pass, each line is "name: 8 receive columns 8 transmit columns"
+    */
+
+    static network_stats network;
+    network.count = 0;
+
+    // Re-reads the held open /proc/net/dev
+    static proc_file dev_file = PROC_FILE_INIT;
+    if (!readProcFile(&dev_file, "/proc/net/dev")){ return; }
+    network.timestamp = monotonicNow();
+
+    const char* end = dev_file.buffer + dev_file.length;
+    for (const char* line = dev_file.buffer; line < end && network.count < MAX_INTERFACES; line = procNextLine(line, end)){
+        // The two header lines have no ':' before their end
+        const char* cursor = line;
+        while (cursor < end && *cursor == ' '){ cursor++; }
+        const char* name = cursor;
+        while (cursor < end && *cursor != ':' && *cursor != '\n'){ cursor++; }
+        if (cursor >= end || *cursor != ':'){ continue; }
+
+        interface_counters* i = &network.interface[network.count];
+        size_t length = cursor - name;
+        if (length >= IFNAMSIZ){ length = IFNAMSIZ - 1; }
+        memcpy(i->name, name, length);
+        i->name[length] = '\0';
+
+        // Large counters follow the ':' without a blank
+        cursor++;
+        long int columns[12];
+        int read_columns = 0;
+        while (read_columns < 12 && procNextInteger(&cursor, end, &columns[read_columns])){ read_columns++; }
+        if (read_columns < 12){ continue; }
+
+        for (int f = 0; f < NET_FIELDS; f++){ i->field[f] = (unsigned long int) columns[net_columns[f]]; }
+        network.count++;
+    }
+
+    // Only the used entries are sent
+    size_t size = offsetof(network_stats, interface) + network.count * sizeof(interface_counters);
+    if (collectorWrite(pipefd, &size, sizeof(size)) == -1 || collectorWrite(pipefd, &network, size) != (ssize_t) size) {
+        perror("Error writing to pipe");
+        terminateCollector();
+    }
+}
+
+ssize_t readInterfaces(collector* c, network_stats* network){
+    /**
+    * Reads one sample written by networkStats
+    *
+    * @c: collector with a sample ready
+    * @network: structure that receives the counters
+    *
+    * Return: number of bytes read, -1 on error
+    */
+
+    size_t size;
+    if (collectorRead(c, &size, sizeof(size)) != sizeof(size) || size < offsetof(network_stats, interface) || size > sizeof(network_stats)
+        || collectorRead(c, network, size) != (ssize_t) size){
+        network->count = 0;
+        return -1;
+    }
+
+    return sizeof(size) + size;
+}
+
+static unsigned long long counterDelta(unsigned long long current, unsigned long long previous){
+    /**
+    * Difference of a counter between two samples
+    *
+    * /proc/net/dev prints the counters as unsigned long: 64 bits wide on a 64 bit kernel, where a counter going down
+    * means the interface was reset or recreated and counts from zero again. Only a 32 bit build can see one wrap around.
+    */
+
+    if (current >= previous){ return current - previous; }
+#if ULONG_MAX == UINT32_MAX
+    return current + (UINT32_MAX - previous) + 1;
+#else
+    return current;
+#endif
+}
+
+static size_t nameHash(const char* name){
+    // FNV-1a over the interface name
+    size_t h = 2166136261u;
+    for (; *name != '\0'; name++){ h = (h ^ (unsigned char) *name) * 16777619u; }
+    return h & (NAME_INDEX - 1);
+}
+
+void networkDeltas(const network_stats* current, network_stats* previous, network_rates* rates){
+    /**
+    * Computes the per second rates of every interface since the previous sample
+    *
+    * @current: counters of this sample
+    * @previous: counters of the previous sample, replaced by the current ones for the next iteration
+    * @rates: receives the rates of each interface of current, zero for an interface that just appeared
+    *
+    * Interfaces are matched by name. The same position is tried first, so the common case costs one compare;
+    * once interfaces come and go the previous names are indexed in a hash table, keeping thousands of veth devices linear.
+    * Interfaces that disappeared are simply not carried over.
+    */
+
+    static int index[NAME_INDEX];
+    bool indexed = false;
+    double elapsed = previous->count > 0 ? (double)(current->timestamp - previous->timestamp) / NSEC_PER_SEC : 0;
+
+    rates->count = current->count;
+    for (int i = 0; i < current->count; i++){
+        const interface_counters* now = &current->interface[i];
+        memset(rates->rate[i], 0, sizeof(rates->rate[i]));
+
+        const interface_counters* before = NULL;
+        if (i < previous->count && strcmp(previous->interface[i].name, now->name) == 0){ before = &previous->interface[i]; }
+        else if (previous->count > 0){
+            if (!indexed){
+                // Slots hold the position + 1 of a previous interface, 0 marks a free slot
+                memset(index, 0, sizeof(index));
+                for (int k = 0; k < previous->count; k++){
+                    size_t h = nameHash(previous->interface[k].name);
+                    while (index[h] != 0){ h = (h + 1) & (NAME_INDEX - 1); }
+                    index[h] = k + 1;
+                }
+                indexed = true;
+            }
+            for (size_t h = nameHash(now->name); index[h] != 0; h = (h + 1) & (NAME_INDEX - 1)){
+                if (strcmp(previous->interface[index[h] - 1].name, now->name) == 0){
+                    before = &previous->interface[index[h] - 1];
+                    break;
+                }
+            }
+        }
+        if (before == NULL || elapsed <= 0){ continue; }
+
+        for (int f = 0; f < NET_FIELDS; f++){ rates->rate[i][f] = counterDelta(now->field[f], before->field[f]) / elapsed; }
+    }
+
+    previous->timestamp = current->timestamp;
+    previous->count = current->count;
+    memcpy(previous->interface, current->interface, current->count * sizeof(interface_counters));
+}
+
+void networkOutput(frame* f, const network_stats* network, const network_rates* rates){
+    /**
+    * Prints the receive and transmit rates of every interface that had traffic
+    *
+    * @f: frame the output is added to
+    * @network: counters of the current sample, for the interface names
+    * @rates: rates computed by networkDeltas
+    *
+    * Interfaces without any traffic are counted on one line so hosts with thousands of idle veth devices stay readable
+    */
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Network ### (rx MB/s pkt/s err/s drop/s -- tx MB/s pkt/s err/s drop/s)\n");
+
+    int idle = 0;
+    for (int i = 0; i < network->count; i++){
+        const double* r = rates->rate[i];
+
+        bool active = false;
+        for (int k = 0; k < NET_FIELDS; k++){ active |= r[k] > 0; }
+        if (!active){ idle++; continue; }
+
+        framePrintf(f, " %-15s %8.2f %8.0f %6.0f %6.0f -- %8.2f %8.0f %6.0f %6.0f\n", network->interface[i].name,
+                    r[NET_RX_BYTES] / (1024 * 1024), r[NET_RX_PACKETS], r[NET_RX_ERRORS], r[NET_RX_DROPS],
+                    r[NET_TX_BYTES] / (1024 * 1024), r[NET_TX_PACKETS], r[NET_TX_ERRORS], r[NET_TX_DROPS]);
+    }
+    if (idle > 0){ framePrintf(f, " %d idle interface%s\n", idle, idle == 1 ? "" : "s"); }
+}
@@ -0,0 +1,56 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <net/if.h>
+#include "stats_functions.h"
+
+#define MAX_INTERFACES 4096
+
+// Columns of /proc/net/dev that are used
+enum interface_field {
+
+    NET_RX_BYTES,
+    NET_RX_PACKETS,
+    NET_RX_ERRORS,
+    NET_RX_DROPS,
+    NET_TX_BYTES,
+    NET_TX_PACKETS,
+    NET_TX_ERRORS,
+    NET_TX_DROPS,
+    NET_FIELDS
+
+};
+
+typedef struct interface_counters {
+
+    char name[IFNAMSIZ];
+    unsigned long long field[NET_FIELDS];
+
+} interface_counters;
+
+// Counters of every network interface at one sample
+typedef struct network_stats {
+
+    long long timestamp;        // monotonic time of the read in nanoseconds
+    int count;
+    interface_counters interface[MAX_INTERFACES];
+
+} network_stats;
+
+// Per second rates of every interface, in the order of the current sample
+typedef struct network_rates {
+
+    int count;
+    double rate[MAX_INTERFACES][NET_FIELDS];
+
+} network_rates;
+
+void networkStats(int pipefd[2]);
+
+ssize_t readInterfaces(struct collector* c, network_stats* network);
+
+void networkDeltas(const network_stats* current, network_stats* previous, network_rates* rates);
+
+void networkOutput(frame* f, const network_stats* network, const network_rates* rates);
+
+#endif // NETWORK_H
@@ -0,0 +1,49 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "collectors.h"
+#include "scheduler.h"
+#include "output.h"
+#include "statistics.h"
+#include "profile.h"
+
+// Command line arguments selected by the user
+typedef struct options {
+
+    int samples;
+    long long interval;     // time between samples in nanoseconds
+    long long adaptive_min; // bounds of the interval with --adaptive, both 0 for a fixed interval
+    long long adaptive_max;
+    bool system;
+    bool user;
+    bool graphics;
+    bool sequential;
+    bool per_cpu;
+    bool disks;
+    bool network;
+    bool available;         // used memory is total minus available instead of total minus free
+    exec_mode mode;
+    int history;            // capacity of the sample ring buffer
+    const char* retain;     // RESOLUTION:SPAN tiers of the retention store, NULL if samples are not retained
+    long long range;        // time before now shown in the retention section, 0 for everything retained
+    output_format format;   // text frames or machine readable records
+    const char* record;     // file the raw samples are appended to, NULL if not recording
+    const char* replay;     // recording to display instead of live samples, NULL if live
+    long long replay_from;  // wall clock time in nanoseconds the replay starts at
+    bool replay_relative;   // replay_from is an offset from the first record
+    double speed;           // replay speed relative to the recorded pace, 0 for as fast as possible
+    int window;             // number of samples covered by the sliding window statistics
+    int top;                // number of processes in the top section, 0 if it is not shown
+    bool profile;           // time every stage of a sample
+    bool profile_frames;    // print the profile on every frame instead of only at the end
+    const char* daemon;     // shared memory segment the samples are published to instead of shown, NULL if not a daemon
+    const char* attach;     // shared memory segment of a daemon the samples are read from, NULL if not attached
+    const char* listen;     // ADDR:PORT or unix:PATH the Prometheus metrics are served on, NULL if not serving
+    const char* agent;      // HOST:PORT of the aggregator the samples are streamed to instead of shown, NULL if not an agent
+    const char* aggregate;  // PORT or ADDR:PORT the samples of the agents are received on, NULL if not an aggregator
+    const char* cgroup;     // cgroup v2 directory or path to show, "" for the cgroup of this process, NULL if not shown
+    bool pressure;          // show the run queue, load average and pressure stall information
+
+} options;
+
+#endif // OPTIONS_H
@@ -0,0 +1,500 @@
+#include "output.h"
+
+#define WRITER_CAPACITY 65536
+
+// Samples taken less than 10 ms apart are written in batches
+#define BATCH_INTERVAL 10000000LL
+
+static const char* cpu_fields[] = { "user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal", "guest", "guest_nice" };
+
+bool parseFormat(const char* name, output_format* format){
+    /**
+    * Converts the value of the --format= argument
+    *
+    * @name: "text", "jsonl" or "csv"
+    * @format: receives the format
+    *
+    * Return: true if the name was recognised
+    */
+
+    if (strcmp(name, "text") == 0){ *format = FORMAT_TEXT; }
+    else if (strcmp(name, "jsonl") == 0){ *format = FORMAT_JSONL; }
+    else if (strcmp(name, "csv") == 0){ *format = FORMAT_CSV; }
+    else { return false; }
+
+    return true;
+}
+
+bool writerInit(writer* w, int fd, size_t capacity){
+    /**
+    * Allocates the buffer of a writer
+    *
+    * @w: writer to initialize
+    * @fd: file descriptor the buffer is flushed to, -1 for text built in memory
+    * @capacity: size of the buffer, it is flushed when it would overflow, or doubled when there is no file descriptor
+    *
+    * Return: false if the allocation failed
+    */
+
+    w->fd = fd;
+    w->length = 0;
+    w->capacity = capacity;
+    w->buffer = malloc(capacity);
+    return w->buffer != NULL;
+}
+
+void writerFree(writer* w){
+    /**
+    * Flushes what is left and releases the buffer
+    */
+
+    if (w->buffer != NULL && w->fd != -1){ writerFlush(w); }
+    free(w->buffer);
+    w->buffer = NULL;
+}
+
+void writerFlush(writer* w){
+    /**
+    * Writes the buffered bytes to the file descriptor
+    */
+
+    size_t written = 0;
+    while (written < w->length){
+        ssize_t result = write(w->fd, w->buffer + written, w->length - written);
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            perror("Error writing output");
+            break;
+        }
+        written += result;
+    }
+    w->length = 0;
+}
+
+void writerBytes(writer* w, const char* text, size_t length){
+    /**
+    * Appends bytes, flushing first if they do not fit
+    */
+
+    // A writer without a file descriptor keeps everything, its buffer grows instead
+    if (w->fd == -1 && w->length + length > w->capacity){
+        size_t capacity = w->capacity * 2 > w->length + length ? w->capacity * 2 : w->length + length;
+        char* larger = realloc(w->buffer, capacity);
+        if (larger == NULL){
+            perror("Error growing output buffer");
+            return;
+        }
+        w->buffer = larger;
+        w->capacity = capacity;
+    }
+
+    if (w->length + length > w->capacity){ writerFlush(w); }
+
+    // Text larger than the whole buffer goes straight out
+    if (length > w->capacity){
+        w->length = 0;
+        while (length > 0){
+            ssize_t result = write(w->fd, text, length);
+            if (result == -1){
+                if (errno == EINTR){ continue; }
+                perror("Error writing output");
+                return;
+            }
+            text += result;
+            length -= result;
+        }
+        return;
+    }
+
+    memcpy(w->buffer + w->length, text, length);
+    w->length += length;
+}
+
+void writerString(writer* w, const char* text){
+    /**
+    * Appends a null terminated string
+    */
+
+    writerBytes(w, text, strlen(text));
+}
+
+void writerInteger(writer* w, long long value){
+    /**
+    * Appends a decimal integer, digits are produced right to left in a small stack buffer
+    */
+
+    char digits[24];
+    int start = sizeof(digits);
+    unsigned long long magnitude = value < 0 ? -(unsigned long long) value : (unsigned long long) value;
+
+    do {
+        digits[--start] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    if (value < 0){ digits[--start] = '-'; }
+
+    writerBytes(w, digits + start, sizeof(digits) - start);
+}
+
+void writerFixed(writer* w, double value, int decimals){
+    /**
+    * Appends a number with a fixed number of decimals, ex. 12.34 with 2 decimals
+    *
+    * @w: writer
+    * @value: number to write, values that are not finite are written as 0
+    * @decimals: number of digits after the decimal point, at most 9
+    *
+    * A value too large for the fixed point range of a long long once scaled is formatted by snprintf instead
+    */
+
+    if (!isfinite(value)){ value = 0; }
+
+    long long scale = 1;
+    for (int d = 0; d < decimals; d++){ scale *= 10; }
+
+    if (fabs(value * scale) >= 9e18){
+        char text[400];
+        int length = snprintf(text, sizeof(text), "%.*f", decimals, value);
+        writerBytes(w, text, length < (int) sizeof(text) ? length : (int) sizeof(text) - 1);
+        return;
+    }
+
+    // Round once in fixed point so that the integer and fractional parts agree
+    long long scaled = (long long)(value * scale + (value < 0 ? -0.5 : 0.5));
+    if (scaled < 0){
+        writerBytes(w, "-", 1);
+        scaled = -scaled;
+    }
+
+    writerInteger(w, scaled / scale);
+    if (decimals == 0){ return; }
+
+    char fraction[16];
+    long long rest = scaled % scale;
+    for (int d = decimals - 1; d >= 0; d--){
+        fraction[d] = '0' + rest % 10;
+        rest /= 10;
+    }
+    writerBytes(w, ".", 1);
+    writerBytes(w, fraction, decimals);
+}
+
+static void writerJsonString(writer* w, const char* text){
+    /**
+    * Appends the characters of a JSON string, without its quotes
+    *
+    * Quotes and backslashes are escaped and control characters written as \u00XX, interface names
+    * may contain any of them
+    */
+
+    static const char hex[] = "0123456789abcdef";
+    for (const char* c = text; *c != '\0'; c++){
+        unsigned char byte = (unsigned char) *c;
+        if (byte == '"' || byte == '\\'){ writerBytes(w, "\\", 1); }
+        if (byte < 0x20){
+            char escaped[6] = { '\\', 'u', '0', '0', hex[byte >> 4], hex[byte & 15] };
+            writerBytes(w, escaped, sizeof(escaped));
+            continue;
+        }
+        writerBytes(w, c, 1);
+    }
+}
+
+bool outputInit(sample_output* o, output_format format, int fd, bool system, bool user, long long interval){
+    /**
+    * Prepares the machine readable output of a run
+    *
+    * @o: output to initialize
+    * @format: FORMAT_JSONL or FORMAT_CSV
+    * @fd: where the records go, usually standard output
+    * @system: true if the memory and cpu fields are written
+    * @user: true if the number of sessions is written
+    * @interval: time between samples, fast runs batch several samples per write
+    *
+    * Return: false if the buffer could not be allocated
+    */
+
+    o->format = format;
+    o->system = system;
+    o->user = user;
+    o->core_columns = -1;
+    o->batch = interval < BATCH_INTERVAL;
+
+    return writerInit(&o->out, fd, WRITER_CAPACITY);
+}
+
+static void csvHeader(sample_output* o, const cpu_cores* cores){
+    /**
+    * Writes the CSV column names, the per-core columns are those of the first sample
+    */
+
+    writer* w = &o->out;
+    writerString(w, "timestamp_ns,interval_ns");
+
+    if (o->system){
+        writerString(w, ",total_memory_gb,used_memory_gb,total_virtual_gb,used_virtual_gb,available_gb,used_available_gb");
+        writerString(w, ",buffers_gb,cached_gb,shmem_gb,dirty_gb,writeback_gb,swap_cached_gb");
+        for (int k = 0; k < 10; k++){
+            writerString(w, ",cpu_");
+            writerString(w, cpu_fields[k]);
+        }
+        writerString(w, ",cpu_use");
+    }
+    if (o->user){ writerString(w, ",sessions"); }
+
+    o->core_columns = cores != NULL ? cores->count : 0;
+    for (int c = 0; c < o->core_columns; c++){
+        writerString(w, ",cpu");
+        writerInteger(w, cores->id[c]);
+        writerString(w, "_use");
+    }
+    writerBytes(w, "\n", 1);
+}
+
+void outputSample(sample_output* o, const sample* s, const cpu_cores* cores, const double* core_use, int sessions, const process_sampler* top,
+                  const disk_stats* disks, const disk_rates* disk_rate, const network_stats* network, const network_rates* network_rate,
+                  const cgroup_stats* cgroup, const cgroup_rates* cgroup_rate, const pressure_stats* pressure, const pressure_rates* pressure_rate){
+    /**
+    * Writes the record of one sample
+    *
+    * @o: output of the run
+    * @s: sample with its raw memory and cpu values
+    * @cores: per-core counters, NULL if --per-cpu is not selected
+    * @core_use: utilization of every core in percent, NULL if --per-cpu is not selected
+    * @sessions: number of user sessions
+    * @top: processes using the most cpu, NULL if --top is not selected, only written to jsonl since csv has fixed columns
+    * @disks, disk_rate: disk names and rates, NULL if --disks is not selected, only written to jsonl
+    * @network, network_rate: interface names and rates, NULL if --network is not selected, only written to jsonl
+    * @cgroup, cgroup_rate: figures of the cgroup, NULL if --cgroup is not selected, only written to jsonl
+    * @pressure, pressure_rate: load average and stall times, NULL if --pressure is not selected, only written to jsonl
+    *
+    * Memory is written in GB with 6 decimals and utilization in percent with 2 decimals.
+    * The buffer is flushed after every record unless samples arrive faster than the batching interval.
+    */
+
+    writer* w = &o->out;
+    long int cpu_values[10] = { s->cpu.user, s->cpu.nice, s->cpu.system, s->cpu.idle, s->cpu.iowait, s->cpu.irq, s->cpu.softirq, s->cpu.steal, s->cpu.guest, s->cpu.guest_nice };
+
+    if (o->format == FORMAT_CSV){
+        if (o->core_columns < 0){ csvHeader(o, cores); }
+
+        writerInteger(w, s->timestamp);
+        writerBytes(w, ",", 1); writerInteger(w, s->interval);
+        if (o->system){
+            const double memory_values[12] = { s->mem.total_memory, s->mem.used_memory, s->mem.total_virtual, s->mem.used_virtual,
+                                               s->mem.available, s->mem.used_available, s->mem.buffers, s->mem.cached,
+                                               s->mem.shmem, s->mem.dirty, s->mem.writeback, s->mem.swap_cached };
+            for (int k = 0; k < 12; k++){ writerBytes(w, ",", 1); writerFixed(w, memory_values[k], 6); }
+            for (int k = 0; k < 10; k++){ writerBytes(w, ",", 1); writerInteger(w, cpu_values[k]); }
+            writerBytes(w, ",", 1); writerFixed(w, s->cpu_use, 2);
+        }
+        if (o->user){ writerBytes(w, ",", 1); writerInteger(w, sessions); }
+
+        // Columns are fixed by the header, cores that went away leave their columns empty
+        for (int c = 0; c < o->core_columns; c++){
+            writerBytes(w, ",", 1);
+            if (cores != NULL && c < cores->count){ writerFixed(w, core_use[c], 2); }
+        }
+        writerBytes(w, "\n", 1);
+    }
+    else {
+        writerString(w, "{\"timestamp_ns\":");
+        writerInteger(w, s->timestamp);
+        writerString(w, ",\"interval_ns\":");
+        writerInteger(w, s->interval);
+
+        if (o->system){
+            writerString(w, ",\"memory\":{\"total_gb\":"); writerFixed(w, s->mem.total_memory, 6);
+            writerString(w, ",\"used_gb\":"); writerFixed(w, s->mem.used_memory, 6);
+            writerString(w, ",\"total_virtual_gb\":"); writerFixed(w, s->mem.total_virtual, 6);
+            writerString(w, ",\"used_virtual_gb\":"); writerFixed(w, s->mem.used_virtual, 6);
+            writerString(w, ",\"available_gb\":"); writerFixed(w, s->mem.available, 6);
+            writerString(w, ",\"used_available_gb\":"); writerFixed(w, s->mem.used_available, 6);
+            writerString(w, ",\"buffers_gb\":"); writerFixed(w, s->mem.buffers, 6);
+            writerString(w, ",\"cached_gb\":"); writerFixed(w, s->mem.cached, 6);
+            writerString(w, ",\"shmem_gb\":"); writerFixed(w, s->mem.shmem, 6);
+            writerString(w, ",\"dirty_gb\":"); writerFixed(w, s->mem.dirty, 6);
+            writerString(w, ",\"writeback_gb\":"); writerFixed(w, s->mem.writeback, 6);
+            writerString(w, ",\"swap_cached_gb\":"); writerFixed(w, s->mem.swap_cached, 6);
+            writerString(w, "},\"cpu\":{");
+            for (int k = 0; k < 10; k++){
+                writerString(w, k == 0 ? "\"" : ",\"");
+                writerString(w, cpu_fields[k]);
+                writerString(w, "\":");
+                writerInteger(w, cpu_values[k]);
+            }
+            writerString(w, ",\"use\":"); writerFixed(w, s->cpu_use, 2);
+            writerString(w, ",\"procs_running\":"); writerInteger(w, s->cpu.procs_running);
+            writerString(w, ",\"procs_blocked\":"); writerInteger(w, s->cpu.procs_blocked);
+            writerBytes(w, "}", 1);
+        }
+        if (o->user){ writerString(w, ",\"sessions\":"); writerInteger(w, sessions); }
+
+        if (cores != NULL){
+            writerString(w, ",\"cores\":[");
+            for (int c = 0; c < cores->count; c++){
+                writerString(w, c == 0 ? "{\"id\":" : ",{\"id\":");
+                writerInteger(w, cores->id[c]);
+                writerString(w, ",\"use\":");
+                writerFixed(w, core_use[c], 2);
+                writerBytes(w, "}", 1);
+            }
+            writerBytes(w, "]", 1);
+        }
+        if (top != NULL){
+            writerString(w, ",\"processes\":[");
+            for (int k = 0; k < top->result_count; k++){
+                const process_usage* p = &top->result[k];
+                writerString(w, k == 0 ? "{\"pid\":" : ",{\"pid\":");
+                writerInteger(w, p->pid);
+                writerString(w, ",\"name\":\"");
+                writerJsonString(w, p->name);
+                writerString(w, "\",\"cpu_use\":"); writerFixed(w, p->cpu_use, 2);
+                writerString(w, ",\"rss_mb\":"); writerFixed(w, p->memory, 1);
+                writerBytes(w, "}", 1);
+            }
+            writerBytes(w, "]", 1);
+        }
+        if (disks != NULL){
+            writerString(w, ",\"disks\":[");
+            for (int d = 0; d < disks->count; d++){
+                const disk_rates* r = &disk_rate[d];
+                writerString(w, d == 0 ? "{\"name\":\"" : ",{\"name\":\"");
+                writerJsonString(w, disks->disk[d].name);
+                writerString(w, "\",\"read_iops\":"); writerFixed(w, r->read_iops, 2);
+                writerString(w, ",\"write_iops\":"); writerFixed(w, r->write_iops, 2);
+                writerString(w, ",\"read_bytes\":"); writerFixed(w, r->read_bytes, 0);
+                writerString(w, ",\"write_bytes\":"); writerFixed(w, r->write_bytes, 0);
+                writerString(w, ",\"service_ms\":"); writerFixed(w, r->service_ms, 3);
+                writerString(w, ",\"queue_depth\":"); writerFixed(w, r->queue_depth, 3);
+                writerString(w, ",\"utilization\":"); writerFixed(w, r->utilization, 2);
+                writerBytes(w, "}", 1);
+            }
+            writerBytes(w, "]", 1);
+        }
+        if (network != NULL){
+            static const char* network_keys[NET_FIELDS] = { "\",\"rx_bytes\":", ",\"rx_packets\":", ",\"rx_errors\":", ",\"rx_drops\":",
+                                                            ",\"tx_bytes\":", ",\"tx_packets\":", ",\"tx_errors\":", ",\"tx_drops\":" };
+            writerString(w, ",\"network\":[");
+            for (int i = 0; i < network->count; i++){
+                writerString(w, i == 0 ? "{\"name\":\"" : ",{\"name\":\"");
+                writerJsonString(w, network->interface[i].name);
+                for (int k = 0; k < NET_FIELDS; k++){
+                    writerString(w, network_keys[k]);
+                    writerFixed(w, network_rate->rate[i][k], 2);
+                }
+                writerBytes(w, "}", 1);
+            }
+            writerBytes(w, "]", 1);
+        }
+        if (cgroup != NULL){
+            // Figures the kernel does not provide for the cgroup are -1, like in cgroup_stats
+            writerString(w, ",\"cgroup\":{\"memory_bytes\":"); writerInteger(w, cgroup->memory_current);
+            writerString(w, ",\"memory_limit_bytes\":"); writerInteger(w, cgroup->memory_max);
+            writerString(w, ",\"memory_use\":"); writerFixed(w, cgroup_rate->memory_use, 2);
+            writerString(w, ",\"working_set_bytes\":"); writerFixed(w, cgroup_rate->working_set, 0);
+            writerString(w, ",\"cpu_used\":"); writerFixed(w, cgroup_rate->cpu_used, 3);
+            writerString(w, ",\"cpu_limit\":"); writerFixed(w, cgroup_rate->cpu_limit, 3);
+            writerString(w, ",\"cpu_use\":"); writerFixed(w, cgroup_rate->cpu_use, 2);
+            writerString(w, ",\"throttled_ms\":"); writerFixed(w, cgroup_rate->throttled_ms, 1);
+            writerString(w, ",\"throttled_periods\":"); writerFixed(w, cgroup_rate->throttled_periods, 2);
+            writerBytes(w, "}", 1);
+        }
+        if (pressure != NULL){
+            static const char* pressure_keys[PRESSURE_RESOURCES] = { ",\"cpu\":{", ",\"memory\":{", ",\"io\":{" };
+            static const char* stall_keys[PRESSURE_KINDS] = { "some", "full" };
+            writerString(w, ",\"pressure\":{\"load\":["); writerFixed(w, pressure->load[0], 2);
+            writerBytes(w, ",", 1); writerFixed(w, pressure->load[1], 2);
+            writerBytes(w, ",", 1); writerFixed(w, pressure->load[2], 2);
+            writerString(w, "],\"runnable\":"); writerInteger(w, pressure->runnable);
+            writerString(w, ",\"tasks\":"); writerInteger(w, pressure->tasks);
+            // Stall time in percent of the interval, then the kernel averages; resources and lines the kernel lacks are left out
+            for (int r = 0; r < PRESSURE_RESOURCES && pressure->available; r++){
+                writerString(w, pressure_keys[r]);
+                bool first = true;
+                for (int k = 0; k < PRESSURE_KINDS; k++){
+                    const pressure_line* line = &pressure->line[r][k];
+                    if (line->total < 0){ continue; }
+                    writerString(w, first ? "\"" : ",\""); writerString(w, stall_keys[k]);
+                    writerString(w, "\":"); writerFixed(w, pressure_rate->stalled[r][k], 2);
+                    writerString(w, ",\""); writerString(w, stall_keys[k]);
+                    writerString(w, "_avg10\":"); writerFixed(w, line->avg10, 2);
+                    writerString(w, ",\""); writerString(w, stall_keys[k]);
+                    writerString(w, "_avg60\":"); writerFixed(w, line->avg60, 2);
+                    first = false;
+                }
+                writerBytes(w, "}", 1);
+            }
+            writerBytes(w, "}", 1);
+        }
+        writerString(w, "}\n");
+    }
+
+    // Fast runs fill the buffer before writing, slower runs write every record as soon as it is complete
+    if (!o->batch){ writerFlush(w); }
+}
+
+static void jsonMetric(writer* w, const metric_stats* m){
+    /**
+    * Writes the run and window statistics of a metric as a JSON object
+    */
+
+    summary_row rows[2];
+    metricSummary(m, &rows[0], &rows[1]);
+    static const char* scopes[2] = { "{\"run\":{\"count\":", ",\"window\":{\"count\":" };
+
+    for (int k = 0; k < 2; k++){
+        const summary_row* r = &rows[k];
+        writerString(w, scopes[k]); writerInteger(w, r->count);
+        writerString(w, ",\"min\":"); writerFixed(w, r->min, 6);
+        writerString(w, ",\"max\":"); writerFixed(w, r->max, 6);
+        writerString(w, ",\"mean\":"); writerFixed(w, r->mean, 6);
+        writerString(w, ",\"stddev\":"); writerFixed(w, r->stddev, 6);
+        writerString(w, ",\"p50\":"); writerFixed(w, r->p50, 6);
+        writerString(w, ",\"p95\":"); writerFixed(w, r->p95, 6);
+        writerString(w, ",\"p99\":"); writerFixed(w, r->p99, 6);
+        writerBytes(w, "}", 1);
+    }
+    writerBytes(w, "}", 1);
+}
+
+void outputSummary(sample_output* o, const run_statistics* s){
+    /**
+    * Writes the statistics of the run as a final jsonl record, ex. {"summary":{"window":60,"memory_used_gb":{...}}}
+    *
+    * @o: output of the run, nothing is written for CSV since the rows would not match the header
+    * @s: statistics of the run
+    */
+
+    if (o->format != FORMAT_JSONL){ return; }
+
+    writer* w = &o->out;
+    writerString(w, "{\"summary\":{\"window\":");
+    writerInteger(w, s->window);
+
+    if (s->memory.count > 0){ writerString(w, ",\"memory_used_gb\":"); jsonMetric(w, &s->memory); }
+    if (s->cpu.count > 0){ writerString(w, ",\"cpu_use\":"); jsonMetric(w, &s->cpu); }
+
+    if (s->core_count > 0){
+        writerString(w, ",\"cores\":[");
+        for (int c = 0; c < s->core_count; c++){
+            writerString(w, c == 0 ? "{\"id\":" : ",{\"id\":");
+            writerInteger(w, s->core_ids[c]);
+            writerString(w, ",\"use\":");
+            jsonMetric(w, &s->cores[c]);
+            writerBytes(w, "}", 1);
+        }
+        writerBytes(w, "]", 1);
+    }
+    writerString(w, "}}\n");
+    writerFlush(w);
+}
+
+void outputFree(sample_output* o){
+    /**
+    * Flushes the remaining records and releases the writer
+    */
+
+    writerFree(&o->out);
+}
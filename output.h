@@ -0,0 +1,68 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "stats_functions.h"
+#include "statistics.h"
+#include "processes.h"
+#include "disks.h"
+#include "network.h"
+#include "cgroup.h"
+#include "pressure.h"
+
+typedef enum output_format {
+
+    FORMAT_TEXT,    // human readable frames
+    FORMAT_JSONL,   // one JSON object per line and sample
+    FORMAT_CSV      // one header line, then one row per sample
+
+} output_format;
+
+// Buffered writer that formats numbers itself so a record costs one memcpy per field instead of a printf
+typedef struct writer {
+
+    int fd;
+    char* buffer;
+    size_t length;
+    size_t capacity;
+
+} writer;
+
+// State of the machine readable output of a run
+typedef struct sample_output {
+
+    output_format format;
+    writer out;
+    bool system;
+    bool user;
+    int core_columns;       // number of per-core columns fixed by the first CSV row, -1 before it
+    bool batch;             // samples are so close together that records are only written when the buffer is full
+
+} sample_output;
+
+bool parseFormat(const char* name, output_format* format);
+
+bool writerInit(writer* w, int fd, size_t capacity);
+
+void writerFree(writer* w);
+
+void writerBytes(writer* w, const char* text, size_t length);
+
+void writerString(writer* w, const char* text);
+
+void writerInteger(writer* w, long long value);
+
+void writerFixed(writer* w, double value, int decimals);
+
+void writerFlush(writer* w);
+
+bool outputInit(sample_output* o, output_format format, int fd, bool system, bool user, long long interval);
+
+void outputSample(sample_output* o, const sample* s, const cpu_cores* cores, const double* core_use, int sessions, const process_sampler* top,
+                  const disk_stats* disks, const disk_rates* disk_rate, const network_stats* network, const network_rates* network_rate,
+                  const cgroup_stats* cgroup, const cgroup_rates* cgroup_rate, const pressure_stats* pressure, const pressure_rates* pressure_rate);
+
+void outputSummary(sample_output* o, const run_statistics* s);
+
+void outputFree(sample_output* o);
+
+#endif // OUTPUT_H
@@ -0,0 +1,195 @@
+#include "pressure.h"
+#include "collectors.h"
+#include "scheduler.h"
+
+static const char* resource_names[PRESSURE_RESOURCES] = { "cpu", "memory", "io" };
+static const char* kind_names[PRESSURE_KINDS] = { "some", "full" };
+
+static bool nextDecimal(const char** cursor, const char* end, double* value){
+    /**
+    * Parses the next number of the form "12.34" on the current line, as written by /proc/loadavg and /proc/pressure
+    *
+    * Return: true if a number was parsed
+    */
+
+    long int whole;
+    if (!procNextInteger(cursor, end, &whole)){ return false; }
+
+    double fraction = 0, scale = 1;
+    const char* p = *cursor;
+    if (p < end && *p == '.'){
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++){
+            fraction = fraction * 10 + (*p - '0');
+            scale *= 10;
+        }
+    }
+    *value = whole + fraction / scale;
+    *cursor = p;
+    return true;
+}
+
+static bool nextValue(const char** cursor, const char* line_end){
+    // Moves past the next '=' of the line, to the value of a "key=value" field
+    const char* equal = memchr(*cursor, '=', line_end - *cursor);
+    if (equal == NULL){ return false; }
+    *cursor = equal + 1;
+    return true;
+}
+
+static void parsePressure(const proc_file* file, pressure_line line[PRESSURE_KINDS]){
+    /**
+    * Parses a /proc/pressure file, its lines are "some avg10=0.98 avg60=1.54 avg300=1.74 total=50054098" and the same for "full"
+    *
+    * @file: proc_file that was read
+    * @line: receives the some and full lines, a missing line keeps a total of -1
+    *
+    * The cpu file has no full line before Linux 5.13, and its full line is always zero at the system level
+    */
+
+    const char* end = file->buffer + file->length;
+    for (const char* start = file->buffer; start < end; start = procNextLine(start, end)){
+        const char* line_end = procNextLine(start, end);
+        int kind = strncmp(start, "some ", 5) == 0 ? PRESSURE_SOME : strncmp(start, "full ", 5) == 0 ? PRESSURE_FULL : -1;
+        if (kind == -1){ continue; }
+
+        pressure_line parsed;
+        double avg300;
+        const char* cursor = start;
+        if (nextValue(&cursor, line_end) && nextDecimal(&cursor, line_end, &parsed.avg10)
+            && nextValue(&cursor, line_end) && nextDecimal(&cursor, line_end, &parsed.avg60)
+            && nextValue(&cursor, line_end) && nextDecimal(&cursor, line_end, &avg300)
+            && nextValue(&cursor, line_end) && procNextInteger(&cursor, line_end, &parsed.total)){
+            line[kind] = parsed;
+        }
+    }
+}
+
+void pressureStats(int pipefd[2]){
+    /**
+    * Reads the pressure stall information and the load average and writes them to the pipe
+    *
+    * @pipefd: pipe the pressure_stats struct is written to
+    *
+    * /proc/pressure/cpu, memory and io and /proc/loadavg are held open and re-read with one pread each.
+    * The run queue of /proc/stat is not read here, it comes with the cpu totals of cpuStats.
+    */
+
+    pressure_stats info;
+    static proc_file pressure_files[PRESSURE_RESOURCES] = { PROC_FILE_INIT, PROC_FILE_INIT, PROC_FILE_INIT };
+    static proc_file loadavg_file = PROC_FILE_INIT;
+    static bool pressure_missing[PRESSURE_RESOURCES] = { false };
+
+    // Kernels without PSI have no /proc/pressure and some lack one of its files,
+    // a file that failed to open is not tried again instead of failing an open every sample
+    for (int r = 0; r < PRESSURE_RESOURCES; r++){
+        for (int k = 0; k < PRESSURE_KINDS; k++){
+            info.line[r][k].avg10 = 0;
+            info.line[r][k].avg60 = 0;
+            info.line[r][k].total = -1;
+        }
+    }
+    info.available = 0;
+    for (int r = 0; r < PRESSURE_RESOURCES; r++){
+        if (pressure_missing[r]){ continue; }
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/pressure/%s", resource_names[r]);
+        if (!procOpen(&pressure_files[r], path)){
+            pressure_missing[r] = true;
+            continue;
+        }
+        if (procRead(&pressure_files[r]) == -1){ continue; }
+        parsePressure(&pressure_files[r], info.line[r]);
+        info.available = 1;
+    }
+
+    // /proc/loadavg is "0.13 0.20 0.15 1/73 16088"
+    if (!readProcFile(&loadavg_file, "/proc/loadavg")){ return; }
+    const char* cursor = loadavg_file.buffer;
+    const char* end = loadavg_file.buffer + loadavg_file.length;
+    bool parsed = nextDecimal(&cursor, end, &info.load[0]) && nextDecimal(&cursor, end, &info.load[1]) && nextDecimal(&cursor, end, &info.load[2])
+                  && procNextInteger(&cursor, end, &info.runnable) && cursor < end && *cursor++ == '/' && procNextInteger(&cursor, end, &info.tasks);
+    if (!parsed){
+        fprintf(stderr, "Error: failed to read the load average from /proc/loadavg\n");
+        terminateCollector();
+        return;
+    }
+
+    info.timestamp = monotonicNow();
+
+    if (collectorWrite(pipefd, &info, sizeof(info)) == -1) {
+        perror("Error writing to pipe");
+        terminateCollector();
+    }
+}
+
+void pressureDeltas(const pressure_stats* current, pressure_stats* previous, pressure_rates* rates){
+    /**
+    * Computes the share of the time spent stalled since the previous sample
+    *
+    * @current: counters of this sample
+    * @previous: counters of the previous sample, replaced by the current ones for the next iteration,
+    *            its timestamp is 0 before the first sample
+    * @rates: receives the figures, 0 on the first sample
+    *
+    * The kernel averages only cover 10 s and more, the delta of the total stall time gives the same figure
+    * over exactly the interval between two samples
+    */
+
+    double elapsed_us = previous->timestamp > 0 ? (double)(current->timestamp - previous->timestamp) / 1000 : 0;
+
+    for (int r = 0; r < PRESSURE_RESOURCES; r++){
+        for (int k = 0; k < PRESSURE_KINDS; k++){
+            long int now = current->line[r][k].total, before = previous->line[r][k].total;
+            double percent = now >= 0 && before >= 0 && now >= before && elapsed_us > 0 ? 100 * (now - before) / elapsed_us : 0;
+            rates->stalled[r][k] = percent > 100 ? 100 : percent;
+        }
+    }
+
+    *previous = *current;
+}
+
+void pressureOutput(frame* f, bool graphics, const pressure_stats* pressure, const pressure_rates* rates, const cpu_stats* run_queue){
+    /**
+    * Prints the run queue, the load average and the time tasks were stalled on cpu, memory and io
+    *
+    * @f: frame the output is added to
+    * @graphics: boolean value indicating whether graphics option has been selected
+    * @pressure: figures of the current sample
+    * @rates: stall time computed by pressureDeltas
+    * @run_queue: cpu totals of the same sample holding procs_running and procs_blocked, NULL if the system section is not collected
+    *
+    * The run queue bar is the number of running tasks per cpu, it goes past 100% before the cpu use does
+    * since tasks waiting for a cpu are counted too
+    */
+
+    char bar[64];
+    long int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Pressure ###\n");
+
+    if (run_queue != NULL){
+        double per_cpu = cpus > 0 ? 100.0 * run_queue->procs_running / cpus : 0;
+        frameBar(bar, sizeof(bar), graphics, per_cpu);
+        framePrintf(f, " Run queue: %ld running on %ld cpus (%.0f%%), %ld blocked on I/O%s\n", run_queue->procs_running, cpus, per_cpu,
+                    run_queue->procs_blocked, bar);
+    }
+    framePrintf(f, " Load average: %.2f %.2f %.2f, %ld of %ld tasks runnable\n", pressure->load[0], pressure->load[1], pressure->load[2],
+                pressure->runnable, pressure->tasks);
+
+    if (!pressure->available){
+        framePrintf(f, " Pressure stall information is not available on this kernel\n");
+        return;
+    }
+
+    framePrintf(f, "                stalled   avg10   avg60\n");
+    for (int r = 0; r < PRESSURE_RESOURCES; r++){
+        for (int k = 0; k < PRESSURE_KINDS; k++){
+            const pressure_line* line = &pressure->line[r][k];
+            if (line->total < 0){ continue; }
+            frameBar(bar, sizeof(bar), graphics, rates->stalled[r][k]);
+            framePrintf(f, " %-7s %-4s %8.2f%% %7.2f %7.2f%s\n", k == PRESSURE_SOME ? resource_names[r] : "", kind_names[k],
+                        rates->stalled[r][k], line->avg10, line->avg60, bar);
+        }
+    }
+}
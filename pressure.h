@@ -0,0 +1,46 @@
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include "stats_functions.h"
+
+// Files of /proc/pressure, in the order they are shown
+enum pressure_resource { PRESSURE_CPU, PRESSURE_MEMORY, PRESSURE_IO, PRESSURE_RESOURCES };
+
+// "some": at least one task stalled on the resource, "full": every non-idle task stalled at the same time
+enum pressure_kind { PRESSURE_SOME, PRESSURE_FULL, PRESSURE_KINDS };
+
+// One line of a /proc/pressure file
+typedef struct pressure_line {
+
+    double avg10;               // percent of the time stalled, averaged by the kernel over 10 s
+    double avg60;               // and over 60 s
+    long int total;             // time stalled since boot in microseconds, -1 if the kernel has no such line
+
+} pressure_line;
+
+// Pressure stall information and load average of one sample
+typedef struct pressure_stats {
+
+    long long timestamp;        // monotonic time of the read in nanoseconds
+    int available;              // /proc/pressure exists, the kernel has CONFIG_PSI and was not booted with psi=0
+    pressure_line line[PRESSURE_RESOURCES][PRESSURE_KINDS];
+    double load[3];             // /proc/loadavg over 1, 5 and 15 minutes
+    long int runnable;          // runnable tasks and all tasks, the "1/345" field of /proc/loadavg
+    long int tasks;
+
+} pressure_stats;
+
+// Stall time between two samples
+typedef struct pressure_rates {
+
+    double stalled[PRESSURE_RESOURCES][PRESSURE_KINDS];     // percent of the time since the previous sample
+
+} pressure_rates;
+
+void pressureStats(int pipefd[2]);
+
+void pressureDeltas(const pressure_stats* current, pressure_stats* previous, pressure_rates* rates);
+
+void pressureOutput(frame* f, bool graphics, const pressure_stats* pressure, const pressure_rates* rates, const cpu_stats* run_queue);
+
+#endif // PRESSURE_H
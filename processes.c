@@ -0,0 +1,366 @@
+#include <signal.h>
+#include "processes.h"
+#include "procfs.h"
+#include "scheduler.h"
+
+#define TABLE_INITIAL 1024
+
+static size_t pidHash(pid_t pid, size_t capacity){
+    // Fibonacci hashing spreads consecutive pids over the table
+    return ((unsigned long long) pid * 11400714819323198485ULL) >> 32 & (capacity - 1);
+}
+
+static bool tableResize(process_table* t, size_t capacity, long int generation){
+    /**
+    * Moves the entries seen since a generation into a table of the given capacity, entries of exited processes are dropped
+    *
+    * Return: false if the allocation failed, the table is then unchanged
+    */
+
+    process_slot* slots = calloc(capacity, sizeof(process_slot));
+    if (slots == NULL){ return false; }
+
+    size_t used = 0;
+    for (size_t k = 0; k < t->capacity; k++){
+        const process_slot* old = &t->slots[k];
+        if (old->pid == 0 || old->seen < generation){ continue; }
+
+        size_t h = pidHash(old->pid, capacity);
+        while (slots[h].pid != 0){ h = (h + 1) & (capacity - 1); }
+        slots[h] = *old;
+        used++;
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->capacity = capacity;
+    t->used = used;
+    return true;
+}
+
+static process_slot* tableLookup(process_table* t, pid_t pid, long int generation){
+    /**
+    * Finds the slot of a pid, inserting an empty one if it is not in the table
+    *
+    * Return: the slot, NULL if the table is full and could not grow
+    */
+
+    // Keep the load under one half so probe sequences stay short
+    if ((t->used + 1) * 2 > t->capacity && !tableResize(t, t->capacity * 2, generation)){ return NULL; }
+
+    size_t h = pidHash(pid, t->capacity);
+    while (t->slots[h].pid != 0){
+        if (t->slots[h].pid == pid){ return &t->slots[h]; }
+        h = (h + 1) & (t->capacity - 1);
+    }
+
+    memset(&t->slots[h], 0, sizeof(process_slot));
+    t->slots[h].pid = pid;
+    t->used++;
+    return &t->slots[h];
+}
+
+static bool usageBelow(const process_usage* a, const process_usage* b){
+    // Processes are ranked by cpu use, then by memory so that the first sample still ranks something
+    if (a->cpu_use != b->cpu_use){ return a->cpu_use < b->cpu_use; }
+    return a->memory < b->memory;
+}
+
+static void heapOffer(process_usage* heap, int* count, int capacity, const process_usage* candidate){
+    /**
+    * Keeps the capacity highest ranked processes in a min-heap, the lowest of them at the root
+    */
+
+    int k;
+    if (*count < capacity){
+        // Sift the new entry up from the last position
+        k = (*count)++;
+        while (k > 0 && usageBelow(candidate, &heap[(k - 1) / 2])){
+            heap[k] = heap[(k - 1) / 2];
+            k = (k - 1) / 2;
+        }
+        heap[k] = *candidate;
+        return;
+    }
+
+    if (!usageBelow(&heap[0], candidate)){ return; }
+
+    // Replace the root and sift it down
+    k = 0;
+    while (true){
+        int child = 2 * k + 1;
+        if (child >= *count){ break; }
+        if (child + 1 < *count && usageBelow(&heap[child + 1], &heap[child])){ child++; }
+        if (!usageBelow(&heap[child], candidate)){ break; }
+        heap[k] = heap[child];
+        k = child;
+    }
+    heap[k] = *candidate;
+}
+
+static bool readProcess(int proc_fd, pid_t pid, process_usage* usage, unsigned long long* ticks, unsigned long long* start, long int page_size){
+    /**
+    * Reads the name, state, cpu ticks and resident set of a process from /proc/[pid]/stat
+    *
+    * The resident set is field 24 of stat, the same value as the second field of statm, so one file is enough
+    *
+    * Return: false if the process exited or the line could not be parsed
+    */
+
+    char path[32];
+    snprintf(path, sizeof(path), "%d/stat", pid);
+
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1){ return false; }
+
+    char buffer[1024];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    close(fd);
+    if (length <= 0){ return false; }
+
+    // The name is between the first '(' and the last ')', it may contain spaces and parentheses itself
+    const char* end = buffer + length;
+    const char* open_paren = memchr(buffer, '(', length);
+    const char* close_paren = end - 1;
+    while (close_paren > buffer && *close_paren != ')'){ close_paren--; }
+    if (open_paren == NULL || close_paren <= open_paren || end - close_paren < 4){ return false; }
+
+    size_t name_length = close_paren - open_paren - 1;
+    if (name_length >= TOP_NAME_LENGTH){ name_length = TOP_NAME_LENGTH - 1; }
+    memcpy(usage->name, open_paren + 1, name_length);
+    usage->name[name_length] = '\0';
+
+    usage->pid = pid;
+    usage->state = close_paren[2];
+
+    // Fields 4 to 24 are integers: utime is 14, stime 15, starttime 22 and rss 24
+    const char* cursor = close_paren + 3;
+    long int fields[25];
+    for (int field = 4; field <= 24; field++){
+        if (!procNextInteger(&cursor, end, &fields[field])){ return false; }
+    }
+
+    *ticks = fields[14] + fields[15];
+    *start = fields[22];
+    usage->memory = (double) fields[24] * page_size / (1024 * 1024);
+    return true;
+}
+
+static void workerScan(process_worker* w){
+    /**
+    * Computes the usage of the pids of one worker and keeps its top processes
+    */
+
+    process_sampler* s = w->sampler;
+    w->heap_count = 0;
+
+    for (int k = 0; k < w->pid_count; k++){
+        process_usage usage;
+        unsigned long long ticks, start;
+        if (!readProcess(s->proc_fd, w->pids[k], &usage, &ticks, &start, s->page_size)){ continue; }
+
+        process_slot* slot = tableLookup(&w->table, w->pids[k], s->generation - 1);
+        if (slot == NULL){ continue; }
+
+        // A pid that was reused since the previous scan starts over
+        bool known = slot->seen == s->generation - 1 && slot->start == start && ticks >= slot->ticks;
+        usage.cpu_use = known && s->elapsed_ticks > 0 ? 100 * (ticks - slot->ticks) / s->elapsed_ticks : 0;
+
+        slot->start = start;
+        slot->ticks = ticks;
+        slot->seen = s->generation;
+
+        heapOffer(w->heap, &w->heap_count, s->top, &usage);
+    }
+
+    // Drop the entries of processes that exited once they make up most of the table
+    if (w->table.used > 2 * (size_t) w->pid_count + TABLE_INITIAL){
+        tableResize(&w->table, w->table.capacity, s->generation);
+    }
+}
+
+static void* workerThread(void* arg){
+    process_worker* w = arg;
+    process_sampler* s = w->sampler;
+
+    // Ctrl-C and Ctrl-Z are handled by the main thread
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTSTP);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (true){
+        pthread_barrier_wait(&s->start);
+        if (s->stopping){ break; }
+        workerScan(w);
+        pthread_barrier_wait(&s->done);
+    }
+
+    return NULL;
+}
+
+bool processSamplerInit(process_sampler* s, int top){
+    /**
+    * Opens /proc and starts the scan workers of the --top section
+    *
+    * @s: sampler to initialize
+    * @top: number of processes reported
+    *
+    * One worker per online cpu, at most TOP_MAX_WORKERS, the calling thread acts as the first worker
+    *
+    * Return: false on error (a message has been printed)
+    */
+
+    memset(s, 0, sizeof(process_sampler));
+    s->top = top;
+    s->generation = 1;
+    s->page_size = sysconf(_SC_PAGESIZE);
+
+    s->proc_fd = open(proc_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    s->proc_dir = s->proc_fd == -1 ? NULL : fdopendir(dup(s->proc_fd));
+    if (s->proc_dir == NULL){
+        fprintf(stderr, "Error: failed to open %s. (%s)\n", proc_root, strerror(errno));
+        return false;
+    }
+
+    long int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    s->worker_count = cpus < 1 ? 1 : (cpus > TOP_MAX_WORKERS ? TOP_MAX_WORKERS : cpus);
+
+    s->result = malloc(s->worker_count * top * sizeof(process_usage));
+    if (s->result == NULL){
+        fprintf(stderr, "Error: failed to allocate the process list\n");
+        return false;
+    }
+
+    for (int k = 0; k < s->worker_count; k++){
+        process_worker* w = &s->workers[k];
+        w->sampler = s;
+        w->index = k;
+        w->heap = malloc(top * sizeof(process_usage));
+        w->table.slots = calloc(TABLE_INITIAL, sizeof(process_slot));
+        w->table.capacity = TABLE_INITIAL;
+        if (w->heap == NULL || w->table.slots == NULL){
+            fprintf(stderr, "Error: failed to allocate the process table\n");
+            return false;
+        }
+    }
+
+    pthread_barrier_init(&s->start, NULL, s->worker_count);
+    pthread_barrier_init(&s->done, NULL, s->worker_count);
+
+    for (int k = 1; k < s->worker_count; k++){
+        int error = pthread_create(&s->workers[k].thread, NULL, workerThread, &s->workers[k]);
+        if (error != 0){
+            fprintf(stderr, "Error: failed to create a process scan thread. (%s)\n", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return true;
+}
+
+static int compareUsage(const void* a, const void* b){
+    // Highest ranked first
+    const process_usage* x = a;
+    const process_usage* y = b;
+    return usageBelow(x, y) - usageBelow(y, x);
+}
+
+void processSample(process_sampler* s){
+    /**
+    * Scans every process once and keeps the top ones in s->result
+    *
+    * @s: sampler of the run
+    *
+    * The pids are dealt to the workers by pid, every worker reads its processes and keeps a partial top-N heap,
+    * the heaps are then merged here so only workers * N entries are sorted
+    */
+
+    long long now = monotonicNow();
+    s->elapsed_ticks = s->previous_time > 0 ? (double)(now - s->previous_time) * sysconf(_SC_CLK_TCK) / NSEC_PER_SEC : 0;
+    s->previous_time = now;
+    s->generation++;
+
+    // List the numeric entries of /proc
+    for (int k = 0; k < s->worker_count; k++){ s->workers[k].pid_count = 0; }
+    s->process_count = 0;
+
+    rewinddir(s->proc_dir);
+    struct dirent* entry;
+    while ((entry = readdir(s->proc_dir)) != NULL){
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9'){ continue; }
+
+        pid_t pid = atoi(entry->d_name);
+        process_worker* w = &s->workers[pid % s->worker_count];
+        if (w->pid_count == w->pid_capacity){
+            int capacity = w->pid_capacity == 0 ? 1024 : 2 * w->pid_capacity;
+            pid_t* pids = realloc(w->pids, capacity * sizeof(pid_t));
+            if (pids == NULL){ continue; }
+            w->pids = pids;
+            w->pid_capacity = capacity;
+        }
+        w->pids[w->pid_count++] = pid;
+        s->process_count++;
+    }
+
+    // Run the scan on every worker, the calling thread does the first share
+    pthread_barrier_wait(&s->start);
+    workerScan(&s->workers[0]);
+    pthread_barrier_wait(&s->done);
+
+    // Merge the partial heaps
+    s->result_count = 0;
+    for (int k = 0; k < s->worker_count; k++){
+        memcpy(s->result + s->result_count, s->workers[k].heap, s->workers[k].heap_count * sizeof(process_usage));
+        s->result_count += s->workers[k].heap_count;
+    }
+    qsort(s->result, s->result_count, sizeof(process_usage), compareUsage);
+    if (s->result_count > s->top){ s->result_count = s->top; }
+}
+
+void processSamplerFree(process_sampler* s){
+    /**
+    * Stops the scan workers and releases the tables
+    */
+
+    if (s->worker_count > 0){
+        s->stopping = true;
+        pthread_barrier_wait(&s->start);
+        for (int k = 1; k < s->worker_count; k++){ pthread_join(s->workers[k].thread, NULL); }
+        pthread_barrier_destroy(&s->start);
+        pthread_barrier_destroy(&s->done);
+    }
+
+    for (int k = 0; k < s->worker_count; k++){
+        free(s->workers[k].pids);
+        free(s->workers[k].heap);
+        free(s->workers[k].table.slots);
+    }
+    free(s->result);
+    if (s->proc_dir != NULL){ closedir(s->proc_dir); }
+    if (s->proc_fd != -1){ close(s->proc_fd); }
+    memset(s, 0, sizeof(process_sampler));
+}
+
+void topOutput(frame* f, const process_sampler* s){
+    /**
+    * Prints the processes using the most cpu since the previous sample
+    *
+    * @f: frame the output is added to
+    * @s: sampler holding the result of the last scan
+    *
+    * Always prints top rows so the sections below do not move when fewer processes are ranked
+    */
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Top %d processes ### (%d in total)\n", s->top, s->process_count);
+    framePrintf(f, " %7s %-15s %s %7s %10s\n", "PID", "NAME", "S", "CPU%", "RSS MB");
+
+    for (int k = 0; k < s->top; k++){
+        if (k >= s->result_count){ framePrintf(f, "\n"); continue; }
+
+        const process_usage* p = &s->result[k];
+        framePrintf(f, " %7d %-15s %c %7.2f %10.1f\n", p->pid, p->name, p->state, p->cpu_use, p->memory);
+    }
+}
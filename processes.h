@@ -0,0 +1,86 @@
+#ifndef PROCESSES_H
+#define PROCESSES_H
+
+#include <pthread.h>
+#include <dirent.h>
+#include "stats_functions.h"
+
+#define TOP_MAX_WORKERS 8
+#define TOP_NAME_LENGTH 16      // the kernel truncates process names to 15 characters
+
+// Usage of one process between two samples
+typedef struct process_usage {
+
+    pid_t pid;
+    char state;
+    char name[TOP_NAME_LENGTH];
+    double cpu_use;             // percent of one cpu since the previous sample
+    double memory;              // resident set in MB
+
+} process_usage;
+
+// Cpu ticks of a process at the previous sample, the start time tells a reused pid apart
+typedef struct process_slot {
+
+    pid_t pid;
+    unsigned long long start;
+    unsigned long long ticks;
+    long int seen;              // generation of the last scan that found the process
+
+} process_slot;
+
+// Open addressing hash table from pid to slot
+typedef struct process_table {
+
+    process_slot* slots;
+    size_t capacity;            // power of two
+    size_t used;
+
+} process_table;
+
+struct process_sampler;
+
+// Every worker owns the pids with pid % workers == index, together with their table entries, so no locking is needed
+typedef struct process_worker {
+
+    struct process_sampler* sampler;
+    pthread_t thread;
+    int index;
+    pid_t* pids;
+    int pid_count;
+    int pid_capacity;
+    process_table table;
+    process_usage* heap;        // min-heap of the top processes of this worker
+    int heap_count;
+
+} process_worker;
+
+typedef struct process_sampler {
+
+    int top;
+    int worker_count;
+    process_worker workers[TOP_MAX_WORKERS];
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    bool stopping;
+    int proc_fd;
+    DIR* proc_dir;
+    long long previous_time;
+    double elapsed_ticks;       // clock ticks between the last two scans, 0 on the first scan
+    long int generation;
+    long int page_size;
+    process_usage* result;      // top processes of the last scan, highest cpu use first
+    int result_count;
+    int process_count;
+
+} process_sampler;
+
+bool processSamplerInit(process_sampler* s, int top);
+
+void processSample(process_sampler* s);
+
+void processSamplerFree(process_sampler* s);
+
+void topOutput(frame* f, const process_sampler* s);
+
+#endif // PROCESSES_H
@@ -0,0 +1,147 @@
+#include "procfs.h"
+
+#define PROC_INITIAL_CAPACITY 4096
+
+const char* proc_root = "/proc";
+
+void procPath(char* buffer, size_t size, const char* path){
+    /**
+    * Maps a path under /proc to the same path under proc_root
+    *
+    * @buffer, size: receives the mapped path
+    * @path: absolute path, paths outside of /proc are copied unchanged
+    */
+
+    size_t prefix = strlen("/proc");
+    if (strncmp(path, "/proc", prefix) == 0 && (path[prefix] == '/' || path[prefix] == '\0')){
+        snprintf(buffer, size, "%s%s", proc_root, path + prefix);
+    }
+    else { snprintf(buffer, size, "%s", path); }
+}
+
+bool procOpen(proc_file* file, const char* path){
+    /**
+    * Opens a /proc file once, later calls return immediately while the file is still open
+    *
+    * @file: proc_file to open, must have been initialized with PROC_FILE_INIT
+    * @path: path of the file, a path under /proc is opened under proc_root
+    *
+    * Return: true if the file is open, false if open failed (errno is set)
+    */
+
+    if (file->fd >= 0){ return true; }
+
+    char mapped[4096];
+    procPath(mapped, sizeof(mapped), path);
+    file->fd = open(mapped, O_RDONLY | O_CLOEXEC);
+    if (file->fd == -1){ return false; }
+
+    if (file->buffer == NULL){
+        file->buffer = malloc(PROC_INITIAL_CAPACITY);
+        if (file->buffer == NULL){
+            close(file->fd);
+            file->fd = -1;
+            errno = ENOMEM;
+            return false;
+        }
+        file->capacity = PROC_INITIAL_CAPACITY;
+    }
+    file->length = 0;
+
+    return true;
+}
+
+ssize_t procRead(proc_file* file){
+    /**
+    * Reads the current contents of an open /proc file into its buffer
+    *
+    * @file: proc_file opened with procOpen
+    *
+    * /proc regenerates the contents on every read from offset 0, so pread at offset 0 replaces
+    * the close/open/fopen cycle. The buffer only grows when the file no longer fits,
+    * after the first few samples a read costs one system call and no allocation.
+    *
+    * Return: number of bytes in the buffer, -1 on error
+    */
+
+    size_t total = 0;
+
+    while (true){
+        ssize_t result = pread(file->fd, file->buffer + total, file->capacity - total, total);
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            return -1;
+        }
+        total += result;
+
+        // A short read means the end of the file was reached
+        if (total < file->capacity){ break; }
+
+        // The file filled the whole buffer, double it and keep reading
+        char* larger = realloc(file->buffer, file->capacity * 2);
+        if (larger == NULL){
+            errno = ENOMEM;
+            return -1;
+        }
+        file->buffer = larger;
+        file->capacity *= 2;
+    }
+
+    file->length = total;
+    return total;
+}
+
+void procClose(proc_file* file){
+    /**
+    * Closes the file and releases its buffer
+    */
+
+    if (file->fd >= 0){ close(file->fd); }
+    free(file->buffer);
+
+    file->fd = -1;
+    file->buffer = NULL;
+    file->capacity = 0;
+    file->length = 0;
+}
+
+bool procNextInteger(const char** cursor, const char* end, long int* value){
+    /**
+    * Parses the next decimal integer on the current line
+    *
+    * @cursor: position in the buffer, moved past the number when one is found
+    * @end: end of the buffer
+    * @value: receives the number, left untouched when there is none
+    *
+    * Only blanks are skipped, so the scan stops at the end of the line instead of reading into the next one
+    *
+    * Return: true if a number was parsed
+    */
+
+    const char* p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t')){ p++; }
+
+    bool negative = false;
+    if (p < end && *p == '-'){ negative = true; p++; }
+
+    if (p >= end || *p < '0' || *p > '9'){ return false; }
+
+    long int result = 0;
+    while (p < end && *p >= '0' && *p <= '9'){
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+
+    *value = negative ? -result : result;
+    *cursor = p;
+    return true;
+}
+
+const char* procNextLine(const char* cursor, const char* end){
+    /**
+    * Return: start of the line after the one containing cursor, or end if it was the last line
+    */
+
+    const char* newline = memchr(cursor, '\n', end - cursor);
+    return newline == NULL ? end : newline + 1;
+}
@@ -0,0 +1,39 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// A /proc file that stays open for the whole run and is re-read into the same buffer every sample
+typedef struct proc_file {
+
+    int fd;
+    char* buffer;
+    size_t capacity;
+    size_t length;
+
+} proc_file;
+
+#define PROC_FILE_INIT { -1, NULL, 0, 0 }
+
+// Directory that replaces /proc, set by --proc-root before any collector starts
+extern const char* proc_root;
+
+void procPath(char* buffer, size_t size, const char* path);
+
+bool procOpen(proc_file* file, const char* path);
+
+ssize_t procRead(proc_file* file);
+
+void procClose(proc_file* file);
+
+bool procNextInteger(const char** cursor, const char* end, long int* value);
+
+const char* procNextLine(const char* cursor, const char* end);
+
+#endif // PROCFS_H
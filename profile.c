@@ -0,0 +1,84 @@
+#include "profile.h"
+#include "scheduler.h"
+
+static const char* stage_names[PROFILE_STAGES] = { "spawn/request", "memoryStats", "cpuStats", "userOutput", "coreStats", "diskStats",
+                                                   "networkStats", "cgroupStats", "pressureStats", "process scan", "pipe read", "render",
+                                                   "terminal write", "record output", "whole sample" };
+
+void profilerInit(profiler* p, bool enabled, bool every_frame){
+    /**
+    * Starts the profile of a run
+    *
+    * @p: profiler to initialize
+    * @enabled: boolean value indicating whether --self-profile was selected, every call is a single branch otherwise
+    * @every_frame: boolean value indicating whether the breakdown is printed on every frame
+    */
+
+    memset(p, 0, sizeof(profiler));
+    p->enabled = enabled;
+    p->every_frame = every_frame;
+    if (!enabled){ return; }
+
+    p->wall_start = monotonicNow();
+    getrusage(RUSAGE_SELF, &p->usage_start);
+}
+
+long long profileStart(const profiler* p){
+    /**
+    * Return: the monotonic time a stage starts at, 0 when profiling is disabled
+    */
+
+    return p->enabled ? monotonicNow() : 0;
+}
+
+void profileEnd(profiler* p, enum profile_stage stage, long long start){
+    /**
+    * Records the latency of a stage that started at the time returned by profileStart
+    */
+
+    if (!p->enabled){ return; }
+
+    double ms = (double)(monotonicNow() - start) / NSEC_PER_MSEC;
+    profile_stage_stats* s = &p->stage[stage];
+    s->count++;
+    s->total_ms += ms;
+    if (ms > s->max_ms){ s->max_ms = ms; }
+    sketchAdd(&s->histogram, ms);
+}
+
+static double cpuSeconds(const struct rusage* usage){
+    return usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6 + usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+}
+
+void profileOutput(frame* f, const profiler* p){
+    /**
+    * Prints the latency breakdown of every stage that ran and the cpu time of the monitor
+    *
+    * @f: frame the output is added to
+    * @p: profiler of the run
+    *
+    * Percentiles come from the log bucket sketch of each stage and are accurate to about 1%.
+    * Collector processes are only counted in the children time once they have exited.
+    */
+
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    double wall = (double)(monotonicNow() - p->wall_start) / NSEC_PER_SEC;
+    double cpu = cpuSeconds(&self) - cpuSeconds(&p->usage_start);
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Self profile ### (ms)\n");
+    framePrintf(f, " %-14s %7s %9s %9s %9s %9s\n", "stage", "n", "mean", "p50", "p99", "max");
+
+    for (int k = 0; k < PROFILE_STAGES; k++){
+        const profile_stage_stats* s = &p->stage[k];
+        if (s->count == 0){ continue; }
+
+        framePrintf(f, " %-14s %7ld %9.3f %9.3f %9.3f %9.3f\n", stage_names[k], s->count, s->total_ms / s->count,
+                    sketchQuantile(&s->histogram, 0.50), sketchQuantile(&s->histogram, 0.99), s->max_ms);
+    }
+
+    framePrintf(f, " monitor cpu %.3f s over %.3f s (%.2f%%), exited collectors %.3f s\n", cpu, wall, wall > 0 ? 100 * cpu / wall : 0,
+                cpuSeconds(&children));
+}
@@ -0,0 +1,56 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <sys/resource.h>
+#include "statistics.h"
+
+// Stages of a sample that are timed by --self-profile
+enum profile_stage {
+
+    PROFILE_SPAWN,              // starting the collectors, and the fork of every sample in fork mode
+    PROFILE_MEMORY,             // time from the request until each collector's data is available
+    PROFILE_CPU,
+    PROFILE_USERS,
+    PROFILE_CORES,
+    PROFILE_DISKS,
+    PROFILE_NETWORK,
+    PROFILE_CGROUP,
+    PROFILE_PRESSURE,
+    PROFILE_TOP,                // process scan of the --top section
+    PROFILE_PIPE,               // copying the collector data out of the pipes
+    PROFILE_RENDER,             // building the frame
+    PROFILE_FLUSH,              // writing the changed lines to the terminal
+    PROFILE_OUTPUT,             // writing the jsonl or csv record
+    PROFILE_SAMPLE,             // the whole sample, from the deadline to the end of its output
+    PROFILE_STAGES
+
+};
+
+typedef struct profile_stage_stats {
+
+    long int count;
+    double total_ms;
+    double max_ms;
+    sketch histogram;           // latencies in milliseconds
+
+} profile_stage_stats;
+
+typedef struct profiler {
+
+    bool enabled;
+    bool every_frame;           // print the breakdown on every frame instead of only at the end
+    profile_stage_stats stage[PROFILE_STAGES];
+    long long wall_start;
+    struct rusage usage_start;
+
+} profiler;
+
+void profilerInit(profiler* p, bool enabled, bool every_frame);
+
+long long profileStart(const profiler* p);
+
+void profileEnd(profiler* p, enum profile_stage stage, long long start);
+
+void profileOutput(frame* f, const profiler* p);
+
+#endif // PROFILE_H
@@ -0,0 +1,182 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "record.h"
+#include "scheduler.h"
+
+_Static_assert(sizeof(record_header) <= RECORD_HEADER_SIZE, "record header does not fit in its block");
+
+int recordOpen(const char* path, long long interval){
+    /**
+    * Opens a recording for appending, a new or empty file first receives the header
+    *
+    * @path: file given with --record=
+    * @interval: time between samples in nanoseconds, or the shortest one with --adaptive, written to a new recording
+    *
+    * An existing recording is only extended if it was written with the same record layout.
+    * A record cut short by a crash is dropped so that appended records stay aligned.
+    *
+    * Return: file descriptor opened in append mode, -1 on error (a message has been printed)
+    */
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1){
+        fprintf(stderr, "Error: failed to open recording %s. (%s)\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1){
+        fprintf(stderr, "Error: failed to stat recording %s. (%s)\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0){
+        // New recording, write the header block with the identity of this host
+        char block[RECORD_HEADER_SIZE];
+        memset(block, 0, sizeof(block));
+
+        record_header* header = (record_header*) block;
+        memcpy(header->magic, RECORD_MAGIC, sizeof(header->magic));
+        header->version = RECORD_VERSION;
+        header->record_size = sizeof(record);
+        header->created = realtimeNow();
+        header->interval = interval;
+        if (uname(&header->host) == -1){ memset(&header->host, 0, sizeof(header->host)); }
+
+        if (write(fd, block, sizeof(block)) != sizeof(block)){
+            fprintf(stderr, "Error: failed to write the header of %s. (%s)\n", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Existing recording, check that the records it holds have the same layout
+    record_header header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0
+        || header.version != RECORD_VERSION || header.record_size != sizeof(record)){
+        fprintf(stderr, "Error: %s is not a recording of this version of the program\n", path);
+        close(fd);
+        return -1;
+    }
+
+    off_t whole = RECORD_HEADER_SIZE + (st.st_size - RECORD_HEADER_SIZE) / sizeof(record) * sizeof(record);
+    if (whole != st.st_size && ftruncate(fd, whole) == -1){
+        fprintf(stderr, "Error: failed to drop the partial record of %s. (%s)\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool recordAppend(int fd, const sample* s){
+    /**
+    * Appends the raw values of a sample to a recording with a single write
+    *
+    * @fd: descriptor returned by recordOpen
+    * @s: sample to record
+    *
+    * Return: true on success
+    */
+
+    record r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = s->timestamp;
+    r.interval = s->interval;
+    r.mem = s->mem;
+    r.cpu = s->cpu;
+
+    ssize_t written;
+    while ((written = write(fd, &r, sizeof(r))) == -1 && errno == EINTR){ }
+
+    return written == sizeof(r);
+}
+
+bool replayOpen(replay* r, const char* path){
+    /**
+    * Maps a recording into memory for replay
+    *
+    * @r: replay to initialize
+    * @path: file given with --replay=
+    *
+    * Nothing is read up front, pages are loaded as the records are visited,
+    * so even multi-day recordings open instantly.
+    *
+    * Return: true on success, false on error (a message has been printed)
+    */
+
+    memset(r, 0, sizeof(replay));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1){
+        fprintf(stderr, "Error: failed to open recording %s. (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < RECORD_HEADER_SIZE){
+        fprintf(stderr, "Error: %s is too short to be a recording\n", path);
+        close(fd);
+        return false;
+    }
+
+    r->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (r->data == MAP_FAILED){
+        fprintf(stderr, "Error: failed to map recording %s. (%s)\n", path, strerror(errno));
+        r->data = NULL;
+        return false;
+    }
+    r->size = st.st_size;
+
+    r->header = r->data;
+    if (memcmp(r->header->magic, RECORD_MAGIC, sizeof(r->header->magic)) != 0 || r->header->version != RECORD_VERSION
+        || r->header->record_size != sizeof(record)){
+        fprintf(stderr, "Error: %s is not a recording of this version of the program\n", path);
+        replayClose(r);
+        return false;
+    }
+
+    r->records = (const record*)((const char*) r->data + RECORD_HEADER_SIZE);
+    r->count = (r->size - RECORD_HEADER_SIZE) / sizeof(record);
+
+    // Replay walks the records in order
+    madvise(r->data, r->size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+long int replaySeek(const replay* r, long long timestamp){
+    /**
+    * Finds the first record taken at or after a given time with a binary search
+    *
+    * @r: open replay
+    * @timestamp: wall clock time in nanoseconds
+    *
+    * Records are appended in time order, so only O(log n) records (and pages) are touched
+    *
+    * Return: index of the record, count if every record is older
+    */
+
+    long int low = 0, high = r->count;
+
+    while (low < high){
+        long int middle = low + (high - low) / 2;
+        if (r->records[middle].timestamp < timestamp){ low = middle + 1; }
+        else { high = middle; }
+    }
+
+    return low;
+}
+
+void replayClose(replay* r){
+    /**
+    * Unmaps the recording
+    */
+
+    if (r->data != NULL){ munmap(r->data, r->size); }
+    memset(r, 0, sizeof(replay));
+}
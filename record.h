@@ -0,0 +1,54 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include "stats_functions.h"
+
+#define RECORD_MAGIC "MSSREC01"
+#define RECORD_VERSION 4
+#define RECORD_HEADER_SIZE 512
+
+// Start of a recording, padded to RECORD_HEADER_SIZE bytes so the records that follow are aligned
+typedef struct record_header {
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int64_t created;            // wall clock time in nanoseconds
+    int64_t interval;           // interval the recording was started with, the shortest one of an adaptive schedule
+    struct utsname host;        // identity of the recorded host as shown by footerUsage
+
+} record_header;
+
+// One fixed-size record per sample
+typedef struct record {
+
+    int64_t timestamp;          // wall clock time in nanoseconds
+    int64_t interval;           // time since the previous sample, samples of an adaptive schedule are unevenly spaced
+    memory mem;
+    cpu_stats cpu;
+
+} record;
+
+// A recording mapped into memory for replay
+typedef struct replay {
+
+    void* data;
+    size_t size;
+    const record_header* header;
+    const record* records;
+    long int count;
+
+} replay;
+
+int recordOpen(const char* path, long long interval);
+
+bool recordAppend(int fd, const sample* s);
+
+bool replayOpen(replay* r, const char* path);
+
+long int replaySeek(const replay* r, long long timestamp);
+
+void replayClose(replay* r);
+
+#endif // RECORD_H
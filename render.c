@@ -0,0 +1,331 @@
+#include <sys/ioctl.h>
+#include <errno.h>
+#include "render.h"
+
+static bool reserve(char** buffer, size_t* capacity, size_t needed){
+    /**
+    * Grows a text buffer so it can hold at least needed bytes
+    *
+    * @buffer: pointer to the heap buffer
+    * @capacity: pointer to its size
+    * @needed: required size
+    *
+    * Return: false if the allocation failed
+    */
+
+    if (needed <= *capacity){ return true; }
+
+    size_t size = *capacity == 0 ? 4096 : *capacity;
+    while (size < needed){ size *= 2; }
+
+    char* larger = realloc(*buffer, size);
+    if (larger == NULL){ return false; }
+
+    *buffer = larger;
+    *capacity = size;
+    return true;
+}
+
+static void outAppend(renderer* r, const char* text, size_t length){
+    /**
+    * Appends bytes to the output of the current flush
+    */
+
+    if (!reserve(&r->out, &r->out_capacity, r->out_length + length)){ return; }
+    memcpy(r->out + r->out_length, text, length);
+    r->out_length += length;
+}
+
+static void outLine(renderer* r, const char* line, size_t length){
+    /**
+    * Appends a line, tabs are expanded since a tab moves the cursor without erasing the columns it skips
+    * and stops at the right margin instead of wrapping like the rows are counted
+    */
+
+    long int column = 0;
+    size_t start = 0;
+    for (size_t k = 0; k < length; k++){
+        unsigned char c = line[k];
+        if (c == '\t'){
+            outAppend(r, line + start, k - start);
+            long int stop = (column / 8 + 1) * 8;
+            for (; column < stop; column++){ outAppend(r, " ", 1); }
+            start = k + 1;
+        }
+        else if ((c & 0xC0) != 0x80){ column++; }
+    }
+    outAppend(r, line + start, length - start);
+}
+
+static void outMove(renderer* r, int row){
+    /**
+    * Appends the escape sequence moving the cursor to the start of a row (0 based)
+    */
+
+    char sequence[32];
+    int length = snprintf(sequence, sizeof(sequence), "\033[%d;1H", row + 1);
+    outAppend(r, sequence, length);
+}
+
+static long int lineWidth(const char* line, size_t length){
+    /**
+    * Return: number of terminal columns a line takes, tabs go to the next multiple of 8 and
+    *         UTF-8 continuation bytes take no column
+    */
+
+    long int width = 0;
+    for (size_t k = 0; k < length; k++){
+        unsigned char c = line[k];
+        if (c == '\t'){ width = (width / 8 + 1) * 8; }
+        else if ((c & 0xC0) != 0x80){ width++; }
+    }
+    return width;
+}
+
+static int lineRows(long int width, int columns){
+    // An empty line still takes a row
+    return width == 0 ? 1 : (int)((width + columns - 1) / columns);
+}
+
+static void indexLines(frame* f, int columns){
+    /**
+    * Records the start of every line of the frame and the terminal row it starts on,
+    * a trailing line without a newline counts as a line
+    */
+
+    f->line_count = 0;
+    f->row_count = 0;
+
+    size_t start = 0;
+    while (start < f->length){
+        if (f->line_count == f->line_capacity){
+            int capacity = f->line_capacity == 0 ? 128 : f->line_capacity * 2;
+            size_t* larger = realloc(f->line_start, capacity * sizeof(size_t));
+            if (larger == NULL){ return; }
+            f->line_start = larger;
+            int* rows = realloc(f->line_row, capacity * sizeof(int));
+            if (rows == NULL){ return; }
+            f->line_row = rows;
+            f->line_capacity = capacity;
+        }
+
+        const char* newline = memchr(f->text + start, '\n', f->length - start);
+        size_t end = newline == NULL ? f->length : (size_t)(newline - f->text);
+        f->line_start[f->line_count] = start;
+        f->line_row[f->line_count++] = f->row_count;
+        f->row_count += lineRows(lineWidth(f->text + start, end - start), columns);
+        start = newline == NULL ? f->length : end + 1;
+    }
+}
+
+static size_t lineLength(const frame* f, int k){
+    /**
+    * Return: length of line k without its newline
+    */
+
+    size_t start = f->line_start[k];
+    size_t end = k + 1 < f->line_count ? f->line_start[k + 1] : f->length;
+    if (end > start && f->text[end - 1] == '\n'){ end--; }
+    return end - start;
+}
+
+static void terminalSize(renderer* r){
+    /**
+    * Reads the rows and columns of the terminal, both are a very large number when stdout is not a terminal
+    */
+
+    struct winsize size;
+    bool known = ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0;
+    r->rows = known && size.ws_row > 0 ? size.ws_row : 1 << 30;
+    r->columns = known && size.ws_col > 0 ? size.ws_col : 1 << 30;
+}
+
+void rendererInit(renderer* r, bool sequential){
+    /**
+    * Initializes an empty renderer, the first flush repaints the whole screen
+    *
+    * @r: renderer to initialize
+    * @sequential: true if frames are appended one after another instead of updating the screen
+    */
+
+    memset(r, 0, sizeof(renderer));
+    r->sequential = sequential;
+    r->redraw = true;
+    terminalSize(r);
+}
+
+void rendererFree(renderer* r){
+    /**
+    * Releases the buffers of the renderer
+    */
+
+    free(r->current.text); free(r->current.line_start); free(r->current.line_row);
+    free(r->previous.text); free(r->previous.line_start); free(r->previous.line_row);
+    free(r->out);
+    memset(r, 0, sizeof(renderer));
+}
+
+void rendererInvalidate(renderer* r){
+    /**
+    * Forces the next flush to repaint the whole screen, used when something else wrote to the terminal
+    */
+
+    r->redraw = true;
+}
+
+void rendererResize(renderer* r){
+    /**
+    * Takes the new size of the terminal after a SIGWINCH and repaints the whole screen on the next flush
+    */
+
+    terminalSize(r);
+    r->redraw = true;
+}
+
+frame* frameBegin(renderer* r){
+    /**
+    * Starts a new frame, the buffers of earlier frames are reused
+    *
+    * Return: the frame that the render functions print into
+    */
+
+    r->current.length = 0;
+    r->current.line_count = 0;
+    return &r->current;
+}
+
+void framePrintf(frame* f, const char* format, ...){
+    /**
+    * Appends formatted text to the frame, used by the render functions in place of printf
+    *
+    * @f: frame being built
+    * @format: printf style format string
+    */
+
+    va_list args;
+
+    // Try to format in the space that is left, grow the buffer and retry if it did not fit
+    for (int attempt = 0; attempt < 2; attempt++){
+        size_t space = f->capacity - f->length;
+        va_start(args, format);
+        int length = vsnprintf(f->text == NULL ? NULL : f->text + f->length, space, format, args);
+        va_end(args);
+
+        if (length < 0){ return; }
+        if ((size_t) length < space){
+            f->length += length;
+            return;
+        }
+        if (!reserve(&f->text, &f->capacity, f->length + length + 1)){ return; }
+    }
+}
+
+void frameWrite(frame* f, const char* text, size_t length){
+    /**
+    * Appends raw text to the frame
+    */
+
+    if (!reserve(&f->text, &f->capacity, f->length + length + 1)){ return; }
+    memcpy(f->text + f->length, text, length);
+    f->length += length;
+}
+
+void frameBar(char* text, size_t size, bool graphics, double percent){
+    /**
+    * Formats the bar printed after a percentage, a '|' for every 2 percent like the per-core cpu bars
+    *
+    * @text: receives the bar with a leading space, or an empty string without graphics
+    * @size: size of text, a longer bar is cut to fit
+    * @graphics: boolean value indicating whether graphics option has been selected
+    * @percent: value the bar shows, anything above 100 is drawn as 100
+    */
+
+    text[0] = '\0';
+    if (!graphics){ return; }
+
+    int length = percent > 100 ? 50 : (int)(percent / 2);
+    if (length < 0){ length = 0; }
+    if ((size_t) length + 2 > size){ length = size - 2; }
+    text[0] = ' ';
+    memset(text + 1, '|', length);
+    text[length + 1] = '\0';
+}
+
+void frameFlush(renderer* r){
+    /**
+    * Sends the current frame to the terminal with a single write
+    *
+    * @r: renderer holding the current frame and the frame on screen
+    *
+    * In sequential mode the frame is appended as is. Otherwise the frame is compared line by line with
+    * the one on screen and only the lines that changed are rewritten using cursor addressing, so the
+    * bytes sent per sample follow what changed rather than the size of the whole screen.
+    * The whole screen is repainted on the first frame, after rendererInvalidate, and when the frame
+    * is taller than the terminal since rows that scrolled away can no longer be addressed.
+    * Lines wider than the terminal wrap, so lines are addressed by the row they start on and the height
+    * is counted in rows; a line is only left alone if its text and its row are both unchanged.
+    */
+
+    frame* current = &r->current;
+    frame* previous = &r->previous;
+    r->out_length = 0;
+
+    if (r->sequential){
+        outAppend(r, current->text, current->length);
+    }
+    else {
+        indexLines(current, r->columns);
+
+        if (r->redraw || current->row_count > r->rows){
+            outAppend(r, "\033[H\033[2J", 7);
+            for (int k = 0; k < current->line_count; k++){
+                outLine(r, current->text + current->line_start[k], lineLength(current, k));
+                if (k + 1 < current->line_count || current->text[current->length - 1] == '\n'){ outAppend(r, "\n", 1); }
+            }
+        }
+        else {
+            for (int k = 0; k < current->line_count; k++){
+                size_t length = lineLength(current, k);
+                const char* line = current->text + current->line_start[k];
+
+                if (k < previous->line_count && previous->line_row[k] == current->line_row[k] && lineLength(previous, k) == length
+                    && memcmp(previous->text + previous->line_start[k], line, length) == 0){ continue; }
+
+                // Rewrite the line and clear whatever was left of the longer line it replaces
+                // A line that exactly fills its last row leaves the cursor in the last column, clearing there would erase it
+                outMove(r, current->line_row[k]);
+                outLine(r, line, length);
+                long int width = lineWidth(line, length);
+                if (width == 0 || width % r->columns != 0){ outAppend(r, "\033[K", 3); }
+            }
+
+            // Clear the rows of the previous frame that the new one does not reach
+            if (previous->row_count > current->row_count){
+                outMove(r, current->row_count);
+                outAppend(r, "\033[J", 3);
+            }
+
+            // Leave the cursor under the frame
+            outMove(r, current->row_count);
+        }
+    }
+
+    // Anything printed with stdio has to reach the terminal before the frame
+    fflush(stdout);
+
+    size_t written = 0;
+    while (written < r->out_length){
+        ssize_t result = write(STDOUT_FILENO, r->out + written, r->out_length - written);
+        if (result == -1){
+            if (errno == EINTR){ continue; }
+            break;
+        }
+        written += result;
+    }
+
+    // The frame just written is now the one on screen
+    frame swap = r->previous;
+    r->previous = r->current;
+    r->current = swap;
+    r->redraw = false;
+}
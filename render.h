@@ -0,0 +1,58 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// Text of one frame and the offset of every line in it
+typedef struct frame {
+
+    char* text;
+    size_t length;
+    size_t capacity;
+    size_t* line_start;
+    int* line_row;          // terminal row every line starts on, a line wider than the terminal wraps over several rows
+    int line_count;
+    int line_capacity;
+    int row_count;          // terminal rows of the whole frame
+
+} frame;
+
+// Keeps the frame currently on screen so only the lines that changed are sent to the terminal
+typedef struct renderer {
+
+    frame current;
+    frame previous;
+    bool sequential;        // append every frame instead of updating the screen in place
+    bool redraw;            // the next flush repaints the whole screen
+    int rows;               // rows of the terminal, updated by rendererResize
+    int columns;            // columns of the terminal, updated by rendererResize
+    char* out;
+    size_t out_length;
+    size_t out_capacity;
+
+} renderer;
+
+void rendererInit(renderer* r, bool sequential);
+
+void rendererFree(renderer* r);
+
+void rendererInvalidate(renderer* r);
+
+void rendererResize(renderer* r);
+
+frame* frameBegin(renderer* r);
+
+void framePrintf(frame* f, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void frameWrite(frame* f, const char* text, size_t length);
+
+void frameBar(char* text, size_t size, bool graphics, double percent);
+
+void frameFlush(renderer* r);
+
+#endif // RENDER_H
@@ -0,0 +1,321 @@
+#include <time.h>
+#include "retention.h"
+#include "scheduler.h"
+
+static void formatDuration(char* text, size_t size, long long duration){
+    // Largest unit that divides the duration, ex. "10s", "6h" or "7d", like the values of --retain
+    static const char* units[] = { "d", "h", "m", "s", "ms" };
+    static const long long scales[] = { 86400 * NSEC_PER_SEC, 3600 * NSEC_PER_SEC, 60 * NSEC_PER_SEC, NSEC_PER_SEC, NSEC_PER_MSEC };
+    for (int u = 0; u < 5; u++){
+        if (duration >= scales[u] && duration % scales[u] == 0){
+            snprintf(text, size, "%lld%s", duration / scales[u], units[u]);
+            return;
+        }
+    }
+    snprintf(text, size, "%.3fs", (double) duration / NSEC_PER_SEC);
+}
+
+static bool parseTiers(retention* r, const char* text){
+    /**
+    * Parses the tiers of --retain, a list of RESOLUTION:SPAN such as "1s:10m,10s:6h,1m:7d"
+    *
+    * Every resolution is a multiple of the previous one so that its buckets are made of whole buckets of the finer tier
+    *
+    * Return: false if a tier is invalid (a message has been printed)
+    */
+
+    r->tiers = 0;
+    const char* cursor = text;
+    while (*cursor != '\0'){
+        const char* comma = strchr(cursor, ',');
+        size_t length = comma != NULL ? (size_t)(comma - cursor) : strlen(cursor);
+        char item[64];
+        if (length >= sizeof(item) || r->tiers == RETENTION_MAX_TIERS){
+            fprintf(stderr, "Error: invalid retention '%s', expected at most %d tiers of RESOLUTION:SPAN\n", text, RETENTION_MAX_TIERS);
+            return false;
+        }
+        memcpy(item, cursor, length);
+        item[length] = '\0';
+
+        retention_tier* tier = &r->tier[r->tiers];
+        char* colon = strchr(item, ':');
+        if (colon != NULL){ *colon = '\0'; }
+        if (colon == NULL || !parseInterval(item, &tier->resolution) || !parseInterval(colon + 1, &tier->span) || tier->span < tier->resolution){
+            fprintf(stderr, "Error: invalid retention tier '%.*s', expected RESOLUTION:SPAN such as 10s:6h\n", (int) length, cursor);
+            return false;
+        }
+        if (r->tiers > 0 && (tier->resolution <= tier[-1].resolution || tier->resolution % tier[-1].resolution != 0)){
+            fprintf(stderr, "Error: invalid retention tier '%.*s', its resolution must be a multiple of the previous one\n", (int) length, cursor);
+            return false;
+        }
+        long long capacity = (tier->span + tier->resolution - 1) / tier->resolution;
+        if (capacity > RETENTION_MAX_BUCKETS){
+            fprintf(stderr, "Error: invalid retention tier '%.*s', it would keep more than %d buckets\n", (int) length, cursor, RETENTION_MAX_BUCKETS);
+            return false;
+        }
+        tier->capacity = capacity;
+
+        r->tiers++;
+        cursor += length;
+        if (*cursor == ','){ cursor++; }
+    }
+
+    if (r->tiers == 0){
+        fprintf(stderr, "Error: invalid retention '%s', expected RESOLUTION:SPAN tiers such as %s\n", text, RETENTION_DEFAULT);
+        return false;
+    }
+    return true;
+}
+
+bool retentionInit(retention* r, const char* tiers){
+    /**
+    * Allocates the buckets of every tier, the only allocation of the store
+    *
+    * @r: store to initialize
+    * @tiers: RESOLUTION:SPAN list given with --retain, ex. RETENTION_DEFAULT
+    *
+    * A tier keeps span / resolution buckets of sizeof(retention_bucket) bytes, so the memory is known from the
+    * tiers alone and never grows with the length of the run: about 2.4 MB for the default tiers.
+    *
+    * Return: false if the tiers are invalid or the allocation failed (a message has been printed)
+    */
+
+    memset(r, 0, sizeof(retention));
+    if (!parseTiers(r, tiers)){ return false; }
+
+    for (int t = 0; t < r->tiers; t++){
+        r->tier[t].buckets = calloc(r->tier[t].capacity, sizeof(retention_bucket));
+        if (r->tier[t].buckets == NULL){
+            fprintf(stderr, "Error: failed to allocate %d retention buckets\n", r->tier[t].capacity);
+            retentionFree(r);
+            return false;
+        }
+        r->bytes += r->tier[t].capacity * sizeof(retention_bucket);
+    }
+
+    pthread_mutex_init(&r->lock, NULL);
+    return true;
+}
+
+static void combine(retention_bucket* into, const retention_bucket* b){
+    // Adds the samples of a later bucket to a bucket
+    for (int k = 0; k < RETAIN_SERIES; k++){
+        rollup* a = &into->series[k];
+        const rollup* other = &b->series[k];
+        if (other->min < a->min){ a->min = other->min; }
+        if (other->max > a->max){ a->max = other->max; }
+        a->sum += other->sum;
+        a->last = other->last;
+    }
+    into->weight += b->weight;
+    into->samples += b->samples;
+}
+
+static void mergeInto(retention* r, int t, const retention_bucket* b);
+
+static void closeBucket(retention* r, int t){
+    /**
+    * Moves the open bucket of a tier into its ring, overwriting the oldest one once the ring is full,
+    * and rolls it up into the open bucket of the next tier
+    */
+
+    retention_tier* tier = &r->tier[t];
+    tier->buckets[tier->head] = tier->open;
+    tier->head = (tier->head + 1) % tier->capacity;
+    if (tier->count < tier->capacity){ tier->count++; }
+
+    if (t + 1 < r->tiers){ mergeInto(r, t + 1, &tier->open); }
+    tier->open.samples = 0;
+}
+
+static void mergeInto(retention* r, int t, const retention_bucket* b){
+    /**
+    * Adds a sample, or a closed bucket of the finer tier, to the bucket of its interval in a tier
+    *
+    * A bucket is closed when the first sample of a later interval arrives, a wall clock set back closes it too
+    */
+
+    retention_tier* tier = &r->tier[t];
+    long long start = b->start - b->start % tier->resolution;
+
+    if (tier->open.samples > 0 && tier->open.start != start){ closeBucket(r, t); }
+    if (tier->open.samples > 0){
+        combine(&tier->open, b);
+        return;
+    }
+
+    tier->open = *b;
+    tier->open.start = start;
+    tier->open.duration = tier->resolution;
+}
+
+void retentionAdd(retention* r, const sample* s){
+    /**
+    * Adds a sample to the finest tier, the coarser tiers receive it as their finer buckets close
+    *
+    * @r: store started with retentionInit
+    * @s: sample to keep, at its wall clock timestamp
+    *
+    * Every sample counts for the time since the previous one, so the averages of an adaptive schedule are not
+    * biased toward the busy periods it samples more often. The first sample has no previous one and counts for 1 ns,
+    * enough to be the average of a bucket of its own.
+    */
+
+    double values[RETAIN_SERIES];
+    values[RETAIN_CPU_USE] = s->cpu_use;
+    values[RETAIN_MEMORY_USED] = s->mem.used_memory;
+    values[RETAIN_MEMORY_AVAILABLE] = s->mem.used_available;
+    values[RETAIN_VIRTUAL_USED] = s->mem.used_virtual;
+    values[RETAIN_PROCS_RUNNING] = s->cpu.procs_running;
+
+    retention_bucket b;
+    b.start = s->timestamp;
+    b.duration = 0;
+    b.weight = s->interval > 0 ? s->interval : 1;
+    b.samples = 1;
+    for (int k = 0; k < RETAIN_SERIES; k++){
+        b.series[k].min = values[k];
+        b.series[k].max = values[k];
+        b.series[k].sum = values[k] * b.weight;
+        b.series[k].last = values[k];
+    }
+
+    pthread_mutex_lock(&r->lock);
+    mergeInto(r, 0, &b);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static const retention_bucket* tierBucket(const retention_tier* tier, int k){
+    // k-th bucket of a tier from the oldest, the open bucket comes after the closed ones
+    if (k < tier->count){ return &tier->buckets[(tier->head - tier->count + k + tier->capacity) % tier->capacity]; }
+    return &tier->open;
+}
+
+int retentionQuery(retention* r, long long from, long long to, int max, retention_bucket* out){
+    /**
+    * Returns the rollups of a time range at the finest resolution that still holds its start
+    *
+    * @r: store started with retentionInit
+    * @from, to: wall clock times in nanoseconds, every bucket that overlaps [from, to) is returned
+    * @max: most buckets returned, at most RETENTION_QUERY_MAX, consecutive buckets are merged to fit
+    * @out: receives the buckets from the oldest, their duration is that of the merged buckets
+    *
+    * A range older than every tier gets the coarsest data kept. A coarse bucket only receives the finer ones
+    * once they close, so the newest resolution of a coarse tier is missing from its range.
+    *
+    * Return: number of buckets written to out
+    */
+
+    if (max <= 0){ return 0; }
+    if (max > RETENTION_QUERY_MAX){ max = RETENTION_QUERY_MAX; }
+
+    pthread_mutex_lock(&r->lock);
+
+    // Finest tier that holds the start of the range, else the one reaching furthest back
+    // A tier that never overwrote a bucket holds every sample since the start of the run, the coarser ones hold nothing older
+    const retention_tier* tier = NULL;
+    long long oldest = 0;
+    for (int t = 0; t < r->tiers; t++){
+        const retention_tier* candidate = &r->tier[t];
+        int total = candidate->count + (candidate->open.samples > 0);
+        if (total == 0){ continue; }
+        long long start = tierBucket(candidate, 0)->start;
+        if (tier == NULL || start < oldest){
+            tier = candidate;
+            oldest = start;
+        }
+        if (start <= from || candidate->count < candidate->capacity){
+            tier = candidate;
+            break;
+        }
+    }
+    if (tier == NULL){
+        pthread_mutex_unlock(&r->lock);
+        return 0;
+    }
+
+    int total = tier->count + (tier->open.samples > 0), first = -1, last = -1;
+    for (int k = 0; k < total; k++){
+        const retention_bucket* b = tierBucket(tier, k);
+        if (b->start + b->duration <= from || b->start >= to){ continue; }
+        if (first == -1){ first = k; }
+        last = k;
+    }
+
+    int n = 0;
+    if (first != -1){
+        int group = (last - first + 1 + max - 1) / max;
+        for (int k = first; k <= last; k++){
+            const retention_bucket* b = tierBucket(tier, k);
+            if ((k - first) % group == 0){ out[n++] = *b; }
+            else { combine(&out[n - 1], b); }
+            out[n - 1].duration = b->start + b->duration - out[n - 1].start;
+        }
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return n;
+}
+
+void retentionFree(retention* r){
+    /**
+    * Releases the buckets of every tier
+    */
+
+    for (int t = 0; t < r->tiers; t++){
+        free(r->tier[t].buckets);
+        r->tier[t].buckets = NULL;
+    }
+    if (r->bytes > 0){ pthread_mutex_destroy(&r->lock); }
+    r->tiers = 0;
+    r->bytes = 0;
+}
+
+void retentionOutput(frame* f, retention* r, long long range, bool available){
+    /**
+    * Prints the tiers of the store and the rollups of the last range of time in RETENTION_ROWS rows
+    *
+    * @f: frame the output is added to
+    * @r: store started with retentionInit
+    * @range: nanoseconds before now that are shown, 0 for everything kept
+    * @available: boolean value indicating that used memory is total minus available instead of total minus free
+    */
+
+    char resolution[32], span[32], length[32];
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Retention ### (%d tiers, %.2f MB)\n", r->tiers, r->bytes / (1024.0 * 1024.0));
+
+    pthread_mutex_lock(&r->lock);
+    for (int t = 0; t < r->tiers; t++){
+        const retention_tier* tier = &r->tier[t];
+        formatDuration(resolution, sizeof(resolution), tier->resolution);
+        formatDuration(span, sizeof(span), tier->span);
+        framePrintf(f, " %s buckets for %s: %d of %d kept\n", resolution, span, tier->count, tier->capacity);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    retention_bucket rows[RETENTION_ROWS];
+    long long now = realtimeNow();
+    int n = retentionQuery(r, range > 0 ? now - range : 0, now + 1, RETENTION_ROWS, rows);
+    if (n == 0){
+        framePrintf(f, " No sample kept yet\n");
+        return;
+    }
+
+    int memory = available ? RETAIN_MEMORY_AVAILABLE : RETAIN_MEMORY_USED;
+    framePrintf(f, "     from   length   cpu avg     max   mem GB avg    max   running\n");
+    for (int k = 0; k < n; k++){
+        const retention_bucket* b = &rows[k];
+        char from[32];
+        time_t seconds = b->start / NSEC_PER_SEC;
+        struct tm local;
+        localtime_r(&seconds, &local);
+        strftime(from, sizeof(from), "%H:%M:%S", &local);
+        formatDuration(length, sizeof(length), b->duration);
+
+        double weight = b->weight > 0 ? b->weight : 1;
+        framePrintf(f, " %8s %8s %9.2f %7.2f %12.2f %6.2f %9.2f\n", from, length,
+                    b->series[RETAIN_CPU_USE].sum / weight, b->series[RETAIN_CPU_USE].max,
+                    b->series[memory].sum / weight, b->series[memory].max, b->series[RETAIN_PROCS_RUNNING].sum / weight);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+#include <pthread.h>
+#include "stats_functions.h"
+#include "render.h"
+
+#define RETENTION_MAX_TIERS 4
+#define RETENTION_DEFAULT "1s:10m,10s:6h,1m:7d"
+#define RETENTION_MAX_BUCKETS (1 << 20)     // buckets of one tier, bounds the allocation of a mistyped span
+#define RETENTION_QUERY_MAX 1024            // buckets returned by one query, longer ranges are merged down to it
+#define RETENTION_ROWS 12                   // rows of the retention section
+
+// Figures of a sample kept by the retention store
+typedef enum retention_series {
+
+    RETAIN_CPU_USE,             // percent
+    RETAIN_MEMORY_USED,         // GB, total minus free
+    RETAIN_MEMORY_AVAILABLE,    // GB, total minus available
+    RETAIN_VIRTUAL_USED,        // GB
+    RETAIN_PROCS_RUNNING,
+    RETAIN_SERIES
+
+} retention_series;
+
+// Rollup of one figure over a bucket
+typedef struct rollup {
+
+    double min;
+    double max;
+    double sum;                 // value times the nanoseconds it covered, the average is sum / weight
+    double last;
+
+} rollup;
+
+// Samples of one interval of a tier, rolled up
+typedef struct retention_bucket {
+
+    long long start;            // wall clock time in nanoseconds, a multiple of the resolution of its tier
+    long long duration;         // resolution of the bucket, or of the merged buckets of a query
+    long long weight;           // nanoseconds covered by its samples, the intervals of an adaptive schedule differ
+    int samples;
+    rollup series[RETAIN_SERIES];
+
+} retention_bucket;
+
+// Ring of the closed buckets of one resolution, with the bucket still being filled
+typedef struct retention_tier {
+
+    long long resolution;
+    long long span;
+    retention_bucket* buckets;  // span / resolution buckets allocated at start
+    int capacity;
+    int count;
+    int head;                   // slot of the next closed bucket
+    retention_bucket open;      // samples of the current interval, samples is 0 before the first one
+
+} retention_tier;
+
+// Store of the samples of a long run at decreasing resolutions, its size is fixed by the tiers
+typedef struct retention {
+
+    retention_tier tier[RETENTION_MAX_TIERS];
+    int tiers;
+    size_t bytes;               // memory of the buckets, allocated once by retentionInit
+    pthread_mutex_t lock;       // guards the tiers, queried by the metrics thread while samples are added
+
+} retention;
+
+bool retentionInit(retention* r, const char* tiers);
+
+void retentionAdd(retention* r, const sample* s);
+
+int retentionQuery(retention* r, long long from, long long to, int max, retention_bucket* out);
+
+void retentionFree(retention* r);
+
+void retentionOutput(frame* f, retention* r, long long range, bool available);
+
+#endif // RETENTION_H
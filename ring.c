@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+
+void ringInit(spsc_ring* r){
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    memset(r->slot, 0, sizeof(r->slot));
+}
+
+bool ringPush(spsc_ring* r, ring_message* m){
+    /**
+    * Appends a message, called only by the producer
+    *
+    * The slot is filled before the release store of head, so the consumer that sees the new head also sees the message
+    *
+    * Return: false if the ring is full
+    */
+
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&r->tail, memory_order_acquire) == RING_SLOTS){ return false; }
+
+    r->slot[head & (RING_SLOTS - 1)] = m;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+ring_message* ringPop(spsc_ring* r){
+    /**
+    * Removes the oldest message, called only by the consumer
+    *
+    * Return: the message, NULL if the ring is empty
+    */
+
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&r->head, memory_order_acquire)){ return NULL; }
+
+    ring_message* m = r->slot[tail & (RING_SLOTS - 1)];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return m;
+}
+
+bool ringEmpty(spsc_ring* r){
+    /**
+    * Return: true if the consumer has nothing to pop
+    */
+
+    return atomic_load_explicit(&r->tail, memory_order_relaxed) == atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+void ringFree(spsc_ring* r){
+    /**
+    * Releases the messages left in a ring once both sides have stopped
+    */
+
+    ring_message* m;
+    while ((m = ringPop(r)) != NULL){
+        free(m->data);
+        free(m);
+    }
+}
+
+bool messageAppend(ring_message* m, const void* data, size_t size){
+    /**
+    * Appends bytes to a message, its buffer only grows so a reused message stops allocating after the first samples
+    *
+    * Return: false if the buffer could not grow
+    */
+
+    if (m->length + size > m->capacity){
+        size_t capacity = m->capacity * 2 > m->length + size ? m->capacity * 2 : m->length + size;
+        char* larger = realloc(m->data, capacity);
+        if (larger == NULL){ return false; }
+        m->data = larger;
+        m->capacity = capacity;
+    }
+
+    memcpy(m->data + m->length, data, size);
+    m->length += size;
+    return true;
+}
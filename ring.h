@@ -0,0 +1,41 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define RING_SLOTS 4            // power of two, a collector never has more than one sample outstanding
+#define CACHE_LINE 64
+
+// One sample of a collector, written by the collector thread and read in place by the monitor
+typedef struct ring_message {
+
+    char* data;
+    size_t length;
+    size_t capacity;
+
+} ring_message;
+
+// Single-producer/single-consumer queue of messages, each index is only written by one side
+typedef struct spsc_ring {
+
+    _Alignas(CACHE_LINE) atomic_size_t head;     // next slot the producer fills
+    _Alignas(CACHE_LINE) atomic_size_t tail;     // next slot the consumer empties
+    _Alignas(CACHE_LINE) ring_message* slot[RING_SLOTS];
+
+} spsc_ring;
+
+void ringInit(spsc_ring* r);
+
+bool ringPush(spsc_ring* r, ring_message* m);
+
+ring_message* ringPop(spsc_ring* r);
+
+bool ringEmpty(spsc_ring* r);
+
+void ringFree(spsc_ring* r);
+
+bool messageAppend(ring_message* m, const void* data, size_t size);
+
+#endif // RING_H
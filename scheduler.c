@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "scheduler.h"
+
+long long monotonicNow(){
+    /**
+    * Return: current time of the monotonic clock in nanoseconds
+    */
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+long long realtimeNow(){
+    /**
+    * Return: current wall clock time in nanoseconds since the epoch, used to timestamp samples
+    */
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+bool parseInterval(const char* text, long long* interval){
+    /**
+    * Parses a sampling interval such as "250ms", "1.5s", "500us" or "100" (milliseconds when no unit is given),
+    * the longer units "m", "h" and "d" are there for the spans of --retain
+    *
+    * @text: value given on the command line
+    * @interval: receives the interval in nanoseconds
+    *
+    * Return: true if the text is a positive interval with a known unit
+    */
+
+    char* unit;
+    double value = strtod(text, &unit);
+    if (unit == text || value <= 0){ return false; }
+
+    double scale;
+    if (*unit == '\0' || strcmp(unit, "ms") == 0){ scale = NSEC_PER_MSEC; }
+    else if (strcmp(unit, "s") == 0){ scale = NSEC_PER_SEC; }
+    else if (strcmp(unit, "us") == 0){ scale = 1000; }
+    else if (strcmp(unit, "m") == 0){ scale = 60.0 * NSEC_PER_SEC; }
+    else if (strcmp(unit, "h") == 0){ scale = 3600.0 * NSEC_PER_SEC; }
+    else if (strcmp(unit, "d") == 0){ scale = 86400.0 * NSEC_PER_SEC; }
+    else { return false; }
+
+    *interval = (long long)(value * scale);
+    return *interval > 0;
+}
+
+bool parseIntervalRange(const char* text, long long* min, long long* max){
+    /**
+    * Parses the bounds of an adaptive interval such as "100ms..5s"
+    *
+    * @text: value given on the command line, two intervals of parseInterval separated by ".."
+    * @min, max: receive the bounds in nanoseconds
+    *
+    * Return: true if both bounds are valid intervals and min is not larger than max
+    */
+
+    const char* separator = strstr(text, "..");
+    if (separator == NULL || separator - text >= 64){ return false; }
+
+    char first[64];
+    memcpy(first, text, separator - text);
+    first[separator - text] = '\0';
+    return parseInterval(first, min) && parseInterval(separator + 2, max) && *min <= *max;
+}
+
+void schedulerStart(scheduler* s, long long interval){
+    /**
+    * Anchors the schedule at the current time, the first sample is due immediately
+    *
+    * @s: scheduler to initialize
+    * @interval: time between samples in nanoseconds
+    */
+
+    s->start = monotonicNow();
+    s->interval = interval;
+    s->next = s->start;
+    s->missed = 0;
+    s->min = 0;
+    s->max = 0;
+}
+
+void schedulerAdaptive(scheduler* s, long long min, long long max){
+    /**
+    * Lets the interval of a started schedule change between two bounds, starting from the shortest one
+    *
+    * @s: scheduler started with schedulerStart
+    * @min, max: bounds of the interval in nanoseconds
+    */
+
+    s->min = min;
+    s->max = max;
+    s->interval = min;
+}
+
+void schedulerAdapt(scheduler* s, bool changed){
+    /**
+    * Sets the interval to the next sample from what the last one showed, called before schedulerAdvance
+    *
+    * @s: scheduler of the sampling loop
+    * @changed: the last sample moved by more than the thresholds, see ADAPTIVE_CPU_THRESHOLD
+    *
+    * A change drops the interval to the minimum at once so a short spike is followed closely,
+    * every quiet sample then doubles it until it reaches the maximum.
+    * A fixed schedule is left unchanged.
+    */
+
+    if (s->max <= 0){ return; }
+
+    if (changed){ s->interval = s->min; }
+    else { s->interval = s->interval * 2 < s->max ? s->interval * 2 : s->max; }
+}
+
+long int schedulerAdvance(scheduler* s){
+    /**
+    * Moves the schedule to the deadline of the next sample without sleeping
+    *
+    * @s: scheduler of the sampling loop
+    *
+    * Deadlines are absolute, so the time spent collecting and rendering is absorbed by the wait for
+    * s->next instead of being added to the period and samples do not drift.
+    * When the loop fell behind by more than a whole interval the skipped deadlines are counted as missed
+    * and the schedule jumps forward instead of firing a burst of catch-up samples.
+    *
+    * Return: number of deadlines missed since the previous sample
+    */
+
+    // A zero delay samples back to back
+    if (s->interval <= 0){
+        s->next = monotonicNow();
+        return 0;
+    }
+
+    s->next += s->interval;
+
+    long int missed = 0;
+    long long now = monotonicNow();
+    if (now - s->next >= s->interval){
+        missed = (now - s->next) / s->interval;
+        s->next += missed * s->interval;
+        s->missed += missed;
+    }
+
+    return missed;
+}
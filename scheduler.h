@@ -0,0 +1,43 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
+
+// Changes between two samples that bring an adaptive schedule down to its shortest interval
+#define ADAPTIVE_CPU_THRESHOLD 5.0          // cpu use, in percentage points
+#define ADAPTIVE_MEMORY_THRESHOLD 0.01      // used memory, as a fraction of the total memory
+
+// Absolute deadlines of the sampling loop, the n-th sample is due at start + n * interval
+// An adaptive schedule changes the interval between min and max, every deadline is then the previous one plus the current interval
+typedef struct scheduler {
+
+    long long start;
+    long long interval;
+    long long next;
+    long int missed;
+    long long min;          // bounds of an adaptive interval, both 0 for a fixed one
+    long long max;
+
+} scheduler;
+
+long long monotonicNow();
+
+long long realtimeNow();
+
+bool parseInterval(const char* text, long long* interval);
+
+bool parseIntervalRange(const char* text, long long* min, long long* max);
+
+void schedulerStart(scheduler* s, long long interval);
+
+void schedulerAdaptive(scheduler* s, long long min, long long max);
+
+void schedulerAdapt(scheduler* s, bool changed);
+
+long int schedulerAdvance(scheduler* s);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,232 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include "shared.h"
+#include "scheduler.h"
+
+static shared_segment* mapSegment(int fd, bool writable){
+    void* address = mmap(NULL, sizeof(shared_segment), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    return address == MAP_FAILED ? NULL : (shared_segment*) address;
+}
+
+static bool writerAlive(pid_t writer){
+    // A daemon of another user cannot be signalled but is still running
+    return writer > 0 && (kill(writer, 0) == 0 || errno == EPERM);
+}
+
+bool sharedCreate(shared_view* v, const char* name, long long interval){
+    /**
+    * Creates the shared memory segment a --daemon publishes its samples to
+    *
+    * @v: view to initialize as the writer
+    * @name: name of the POSIX shared memory object, ex. "/mySystemStats"
+    * @interval: sampling interval of the daemon in nanoseconds, the schedule of its clients
+    *
+    * A segment left behind by a daemon that died is reused, one whose daemon is still running is an error
+    *
+    * Return: false on error (a message has been printed)
+    */
+
+    memset(v, 0, sizeof(shared_view));
+    v->name = name;
+    v->writer = true;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd == -1 && errno == EEXIST){
+        fd = shm_open(name, O_RDWR | O_CLOEXEC, 0644);
+        struct stat st;
+        if (fd != -1 && fstat(fd, &st) == 0 && st.st_size == sizeof(shared_segment)){
+            shared_segment* existing = mapSegment(fd, false);
+            bool running = existing != NULL && existing->magic == SHARED_MAGIC && writerAlive(existing->writer);
+            pid_t writer = running ? existing->writer : 0;
+            if (existing != NULL){ munmap(existing, sizeof(shared_segment)); }
+            if (running){
+                fprintf(stderr, "Error: a daemon (pid %d) is already publishing to %s\n", (int) writer, name);
+                close(fd);
+                return false;
+            }
+        }
+    }
+    if (fd == -1 || ftruncate(fd, sizeof(shared_segment)) == -1){
+        fprintf(stderr, "Error: failed to create the shared memory segment %s. (%s)\n", name, strerror(errno));
+        if (fd != -1){ close(fd); }
+        return false;
+    }
+
+    v->segment = mapSegment(fd, true);
+    close(fd);
+    if (v->segment == NULL){
+        fprintf(stderr, "Error: failed to map the shared memory segment %s. (%s)\n", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+
+    // The magic is written last so a client never accepts a half initialized header
+    shared_segment* s = v->segment;
+    atomic_store_explicit(&s->sequence, 0, memory_order_relaxed);
+    memset(&s->snapshot, 0, sizeof(shared_snapshot));
+    s->version = SHARED_VERSION;
+    s->writer = getpid();
+    s->interval = interval;
+    atomic_thread_fence(memory_order_release);
+    s->magic = SHARED_MAGIC;
+
+    return true;
+}
+
+void sharedPublish(shared_view* v, const sample* s, const user_sessions* users){
+    /**
+    * Publishes one sample and the session list to the clients
+    *
+    * @v: view created by sharedCreate
+    * @s: sample to publish
+    * @users: current session list, NULL if the daemon does not collect users
+    *
+    * Seqlock write: the sequence is odd while the snapshot changes and even once it is consistent again.
+    * Clients only ever read the segment and retry when the sequence moved, so they can never delay the daemon.
+    * The session list is only copied when it changed since the previous sample.
+    */
+
+    shared_segment* segment = v->segment;
+    shared_snapshot* snapshot = &segment->snapshot;
+    unsigned long sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    snapshot->timestamp = s->timestamp;
+    snapshot->published = monotonicNow();
+    snapshot->samples++;
+    snapshot->mem = s->mem;
+    snapshot->cpu = s->cpu;
+    snapshot->cpu_use = s->cpu_use;
+
+    if (users != NULL && users->changes != snapshot->session_changes){
+        size_t length = users->text == NULL ? 0 : strlen(users->text);
+
+        // A list that does not fit is cut after its last whole row
+        snapshot->sessions_truncated = length >= SHARED_SESSIONS_SIZE;
+        if (snapshot->sessions_truncated){
+            length = SHARED_SESSIONS_SIZE - 1;
+            while (length > 0 && users->text[length - 1] != '\n'){ length--; }
+        }
+        memcpy(segment->sessions, users->text, length);
+        snapshot->sessions_length = length;
+        snapshot->sessions = users->count;
+        snapshot->session_changes = users->changes;
+    }
+
+    atomic_store_explicit(&segment->sequence, sequence + 2, memory_order_release);
+}
+
+bool sharedAttach(shared_view* v, const char* name){
+    /**
+    * Maps the segment of a running --daemon read-only
+    *
+    * @v: view to initialize as a client
+    * @name: name of the POSIX shared memory object
+    *
+    * Return: false if there is no daemon publishing under that name (a message has been printed)
+    */
+
+    memset(v, 0, sizeof(shared_view));
+    v->name = name;
+    v->session_changes = -1;
+
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1){
+        fprintf(stderr, "Error: failed to open the shared memory segment %s, is mySystemStats --daemon running? (%s)\n", name, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size != sizeof(shared_segment) || (v->segment = mapSegment(fd, false)) == NULL){
+        fprintf(stderr, "Error: %s is not a segment of this version of mySystemStats\n", name);
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    if (v->segment->magic != SHARED_MAGIC || v->segment->version != SHARED_VERSION){
+        fprintf(stderr, "Error: %s is not a segment of this version of mySystemStats\n", name);
+        sharedClose(v);
+        return false;
+    }
+
+    return true;
+}
+
+int sharedRead(shared_view* v, sample* s, user_sessions* users){
+    /**
+    * Copies the latest published sample out of the segment
+    *
+    * @v: view mapped by sharedAttach
+    * @s: receives the timestamp, memory and cpu figures of the sample
+    * @users: receives the session list when it changed since the previous read
+    *
+    * Seqlock read: the copy is kept only if the sequence was even before it and unchanged after it, otherwise it is retried.
+    * A publication is a few copies, a retry is rare and the reader yields while one is in progress.
+    * A daemon that died in the middle of a publication leaves the sequence odd, so the writer is checked while waiting.
+    *
+    * Return: number of samples published so far, 0 if none yet, -1 if the daemon is gone
+    */
+
+    shared_segment* segment = v->segment;
+    shared_snapshot snapshot;
+
+    for (long int spins = 1; ; spins++){
+        unsigned long before = atomic_load_explicit(&segment->sequence, memory_order_acquire);
+        if (before & 1){
+            // One kill(0) every SHARED_ALIVE_SPINS yields, a live daemon finishes long before the first one
+            if (spins % SHARED_ALIVE_SPINS == 0 && !writerAlive(segment->writer)){ return -1; }
+            sched_yield();
+            continue;
+        }
+
+        memcpy(&snapshot, &segment->snapshot, sizeof(snapshot));
+        bool copy_sessions = snapshot.session_changes != v->session_changes && snapshot.sessions_length < SHARED_SESSIONS_SIZE;
+        if (copy_sessions){
+            if (users->text == NULL || users->text_capacity < snapshot.sessions_length + 1){
+                char* larger = realloc(users->text, snapshot.sessions_length + 1024);
+                if (larger == NULL){ return -1; }
+                users->text = larger;
+                users->text_capacity = snapshot.sessions_length + 1024;
+            }
+            memcpy(users->text, segment->sessions, snapshot.sessions_length);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&segment->sequence, memory_order_relaxed) != before){ continue; }
+
+        if (copy_sessions){
+            users->text[snapshot.sessions_length] = '\0';
+            users->count = snapshot.sessions;
+            users->changes++;
+            v->session_changes = snapshot.session_changes;
+        }
+        break;
+    }
+
+    s->timestamp = snapshot.timestamp;
+    s->mem = snapshot.mem;
+    s->cpu = snapshot.cpu;
+    s->cpu_use = snapshot.cpu_use;
+
+    if (!writerAlive(segment->writer)){ return -1; }
+    return snapshot.samples;
+}
+
+void sharedClose(shared_view* v){
+    /**
+    * Unmaps the segment, the daemon also removes it so that no new client attaches to a stopped daemon
+    */
+
+    if (v->segment == NULL){ return; }
+
+    if (v->writer){
+        v->segment->writer = 0;
+        shm_unlink(v->name);
+    }
+    munmap(v->segment, sizeof(shared_segment));
+    v->segment = NULL;
+}
@@ -0,0 +1,63 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "stats_functions.h"
+
+#define SHARED_DEFAULT_NAME "/mySystemStats"
+#define SHARED_MAGIC 0x53534d79     // "yMSS"
+#define SHARED_VERSION 2
+#define SHARED_SESSIONS_SIZE (1 << 20)
+#define SHARED_ALIVE_SPINS 64          // yields of a reader waiting on an odd sequence between two checks of the daemon
+
+// Latest sample published by a --daemon
+typedef struct shared_snapshot {
+
+    long long timestamp;        // wall clock time of the sample in nanoseconds
+    long long published;        // monotonic time of the publication in nanoseconds
+    long int samples;           // number of samples published so far
+    memory mem;
+    cpu_stats cpu;
+    double cpu_use;
+    int sessions;
+    long int session_changes;   // incremented with every new session list, readers only copy the list when it changed
+    size_t sessions_length;
+    bool sessions_truncated;
+
+} shared_snapshot;
+
+// Layout of the POSIX shared memory segment
+typedef struct shared_segment {
+
+    uint32_t magic;
+    uint32_t version;
+    pid_t writer;
+    long long interval;         // sampling interval of the daemon in nanoseconds, the clients sample at it
+    atomic_ulong sequence;      // seqlock, odd while the writer updates the snapshot
+    shared_snapshot snapshot;
+    char sessions[SHARED_SESSIONS_SIZE];
+
+} shared_segment;
+
+// One side of the segment, the daemon maps it writable and every client read-only
+typedef struct shared_view {
+
+    const char* name;
+    shared_segment* segment;
+    bool writer;
+    long int session_changes;   // list last copied by a reader
+
+} shared_view;
+
+bool sharedCreate(shared_view* v, const char* name, long long interval);
+
+void sharedPublish(shared_view* v, const sample* s, const user_sessions* users);
+
+bool sharedAttach(shared_view* v, const char* name);
+
+int sharedRead(shared_view* v, sample* s, user_sessions* users);
+
+void sharedClose(shared_view* v);
+
+#endif // SHARED_H
@@ -0,0 +1,341 @@
+#include <math.h>
+#include "statistics.h"
+
+// Bucket i holds the values in (MIN * GAMMA^(i-1), MIN * GAMMA^i]
+static int bucketIndex(double value){
+    int index = (int) ceil(log(value / SKETCH_MIN_VALUE) / log(SKETCH_GAMMA));
+    if (index < 0){ return 0; }
+    if (index >= SKETCH_BINS){ return SKETCH_BINS - 1; }
+    return index;
+}
+
+static double bucketValue(int index){
+    // Midpoint of the bucket in relative terms, so every value in it is within the relative accuracy
+    return SKETCH_MIN_VALUE * pow(SKETCH_GAMMA, index) * 2 / (1 + SKETCH_GAMMA);
+}
+
+static long int nearestRank(double q, long int total){
+    // Index of the nearest-rank quantile, ceil(q * total) - 1, so p99 of two samples is the larger one
+    // The epsilon keeps 0.95 * 100 from rounding up to the 96th value
+    long int rank = (long int) ceil(q * total - 1e-9) - 1;
+    return rank < 0 ? 0 : rank;
+}
+
+void sketchAdd(sketch* s, double value){
+    /**
+    * Counts a value in its bucket
+    *
+    * @s: sketch
+    * @value: non-negative value, values at or below SKETCH_MIN_VALUE are counted as zero
+    */
+
+    sketchAddCount(s, value, 1);
+}
+
+void sketchAddCount(sketch* s, double value, uint32_t count){
+    /**
+    * Counts a value several times in its bucket, ex. a sample that stands for several intervals
+    */
+
+    if (value <= SKETCH_MIN_VALUE){ s->zero_count += count; }
+    else { s->counts[bucketIndex(value)] += count; }
+    s->total += count;
+}
+
+void sketchMerge(sketch* into, const sketch* from){
+    /**
+    * Adds the counts of one sketch to another, ex. to combine several hosts or several windows
+    */
+
+    into->zero_count += from->zero_count;
+    for (int i = 0; i < SKETCH_BINS; i++){ into->counts[i] += from->counts[i]; }
+    into->total += from->total;
+}
+
+double sketchQuantile(const sketch* s, double q){
+    /**
+    * Estimates a quantile from the bucket counts
+    *
+    * @s: sketch
+    * @q: quantile between 0 and 1, ex. 0.99
+    *
+    * Return: value within about 1% of the exact quantile, 0 for an empty sketch
+    */
+
+    if (s->total == 0){ return 0; }
+
+    long int rank = nearestRank(q, s->total);
+    long int seen = s->zero_count;
+    if (rank < seen){ return 0; }
+
+    for (int i = 0; i < SKETCH_BINS; i++){
+        seen += s->counts[i];
+        if (rank < seen){ return bucketValue(i); }
+    }
+
+    return bucketValue(SKETCH_BINS - 1);
+}
+
+bool metricInit(metric_stats* m, int window){
+    /**
+    * Initializes the statistics of a metric
+    *
+    * @m: statistics to initialize
+    * @window: number of most recent samples covered by the sliding window
+    *
+    * Return: false if the window could not be allocated
+    *
+    * The sorted copy used by the summary is allocated here too, its size follows --window and is kept off the stack
+    */
+
+    memset(m, 0, sizeof(metric_stats));
+    m->window_size = window > 0 ? window : 1;
+    m->window = calloc(m->window_size, sizeof(double));
+    m->window_weight = calloc(m->window_size, sizeof(int));
+    m->sorted = calloc(m->window_size, sizeof(weighted_value));
+    return m->window != NULL && m->window_weight != NULL && m->sorted != NULL;
+}
+
+void metricAdd(metric_stats* m, double value, int weight){
+    /**
+    * Adds a sample in constant time and memory
+    *
+    * @m: statistics of the metric
+    * @value: value of the sample
+    * @weight: number of intervals the sample stands for, 1 when samples are evenly spaced
+    */
+
+    if (m->count == 0 || value < m->min){ m->min = value; }
+    if (m->count == 0 || value > m->max){ m->max = value; }
+
+    // Welford's update keeps the mean and variance numerically stable over long runs, weighted as in West (1979)
+    m->count++;
+    m->weight += weight;
+    double delta = value - m->mean;
+    m->mean += delta * weight / m->weight;
+    m->m2 += weight * delta * (value - m->mean);
+
+    sketchAddCount(&m->quantiles, value, weight);
+
+    m->window[m->window_head] = value;
+    m->window_weight[m->window_head] = weight;
+    m->window_head = (m->window_head + 1) % m->window_size;
+    if (m->window_count < m->window_size){ m->window_count++; }
+}
+
+static int compareValues(const void* a, const void* b){
+    double x = ((const weighted_value*) a)->value, y = ((const weighted_value*) b)->value;
+    return (x > y) - (x < y);
+}
+
+static double weightedQuantile(const weighted_value* sorted, int n, long int weight, double q){
+    // The sample whose weights cover the nearest rank, the same as sorted[ceil(q * n) - 1] when every weight is 1
+    long int rank = nearestRank(q, weight);
+    long int covered = 0;
+    for (int k = 0; k < n; k++){
+        covered += sorted[k].weight;
+        if (covered > rank){ return sorted[k].value; }
+    }
+    return sorted[n - 1].value;
+}
+
+void metricSummary(const metric_stats* m, summary_row* run, summary_row* window){
+    /**
+    * Computes the summary of the whole run and of the sliding window
+    *
+    * @m: statistics of the metric
+    * @run: receives the statistics of every sample, quantiles come from the sketch
+    * @window: receives the exact statistics of the last window samples
+    */
+
+    run->count = m->count;
+    run->min = m->min;
+    run->max = m->max;
+    run->mean = m->mean;
+    run->stddev = m->weight > 1 ? sqrt(m->m2 / (m->weight - 1)) : 0;
+    run->p50 = sketchQuantile(&m->quantiles, 0.50);
+    run->p95 = sketchQuantile(&m->quantiles, 0.95);
+    run->p99 = sketchQuantile(&m->quantiles, 0.99);
+
+    // A bucket midpoint can lie just outside the values actually seen
+    double* estimates[3] = { &run->p50, &run->p95, &run->p99 };
+    for (int k = 0; k < 3; k++){
+        if (*estimates[k] < m->min){ *estimates[k] = m->min; }
+        if (*estimates[k] > m->max){ *estimates[k] = m->max; }
+    }
+
+    memset(window, 0, sizeof(summary_row));
+    int n = m->window_count;
+    window->count = n;
+    if (n == 0){ return; }
+
+    // The window is small, a sorted copy gives exact quantiles
+    weighted_value* sorted = m->sorted;
+    long int weight = 0;
+    double sum = 0;
+    for (int k = 0; k < n; k++){
+        sorted[k].value = m->window[k];
+        sorted[k].weight = m->window_weight[k];
+        weight += sorted[k].weight;
+        sum += sorted[k].value * sorted[k].weight;
+    }
+    qsort(sorted, n, sizeof(weighted_value), compareValues);
+
+    double mean = sum / weight;
+    double squares = 0;
+    for (int k = 0; k < n; k++){ squares += sorted[k].weight * (sorted[k].value - mean) * (sorted[k].value - mean); }
+
+    window->min = sorted[0].value;
+    window->max = sorted[n - 1].value;
+    window->mean = mean;
+    window->stddev = weight > 1 ? sqrt(squares / (weight - 1)) : 0;
+    window->p50 = weightedQuantile(sorted, n, weight, 0.50);
+    window->p95 = weightedQuantile(sorted, n, weight, 0.95);
+    window->p99 = weightedQuantile(sorted, n, weight, 0.99);
+}
+
+void metricFree(metric_stats* m){
+    /**
+    * Releases the sliding window and its sorted copy
+    */
+
+    free(m->window);
+    free(m->window_weight);
+    free(m->sorted);
+    m->window = NULL;
+    m->window_weight = NULL;
+    m->sorted = NULL;
+}
+
+static void summaryRows(frame* f, const char* name, const metric_stats* m){
+    /**
+    * Prints the run and window statistics of a metric as two table rows
+    *
+    * @f: frame the output is added to
+    * @name: label of the metric
+    * @m: statistics of the metric
+    */
+
+    summary_row run, window;
+    metricSummary(m, &run, &window);
+
+    const summary_row* rows[2] = { &run, &window };
+    const char* scopes[2] = { "run", "window" };
+
+    for (int k = 0; k < 2; k++){
+        const summary_row* r = rows[k];
+        framePrintf(f, " %-10s %-6s %6ld %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", name, scopes[k], r->count,
+                    r->min, r->max, r->mean, r->stddev, r->p50, r->p95, r->p99);
+    }
+}
+
+bool statisticsInit(run_statistics* s, int window, bool available, long long quantum){
+    /**
+    * Initializes the statistics of a run
+    *
+    * @s: statistics to initialize
+    * @window: number of most recent samples covered by the sliding window
+    * @available: track the available-based used memory instead of total minus free
+    * @quantum: interval in nanoseconds that weighs 1, the interval of the run or the shortest one with --adaptive, 0 to weigh every sample the same
+    *
+    * Return: false if an allocation failed
+    */
+
+    memset(s, 0, sizeof(run_statistics));
+    s->window = window;
+    s->available = available;
+    s->quantum = quantum;
+    return metricInit(&s->memory, window) && metricInit(&s->cpu, window);
+}
+
+void statisticsAdd(run_statistics* s, long long interval, const sample* current, const cpu_cores* cores, const double* core_use){
+    /**
+    * Adds one sample to the statistics of the run
+    *
+    * @s: statistics of the run
+    * @interval: time since the previous sample in nanoseconds, 0 if unknown
+    * @current: sample with the memory and cpu values, NULL if system information is not selected
+    * @cores: per-core counters, NULL if --per-cpu is not selected
+    * @core_use: utilization of every core in percent, NULL if --per-cpu is not selected
+    *
+    * The utilization of the first sample is the average since boot, it is left out of the cpu statistics.
+    * Cores are tracked in the order of the first sample, cores that appear later are not tracked.
+    * A sample weighs the number of quanta in its interval, so the averages are over time and not over samples:
+    * with --adaptive the samples taken close together during a spike do not outweigh the quiet time between them,
+    * and a sample after a missed deadline counts for the intervals it covers.
+    */
+
+    bool first = (s->samples++ == 0);
+    int weight = 1;
+    if (s->quantum > 0 && interval > s->quantum){ weight = (int) llround((double) interval / s->quantum); }
+
+    if (current != NULL){
+        metricAdd(&s->memory, s->available ? current->mem.used_available : current->mem.used_memory, weight);
+        if (!first){ metricAdd(&s->cpu, current->cpu_use, weight); }
+    }
+
+    if (cores == NULL){ return; }
+
+    if (s->cores == NULL && cores->count > 0){
+        s->cores = calloc(cores->count, sizeof(metric_stats));
+        s->core_ids = malloc(cores->count * sizeof(long int));
+        if (s->cores == NULL || s->core_ids == NULL){
+            fprintf(stderr, "Error: failed to allocate the per-core statistics\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int c = 0; c < cores->count; c++){
+            if (!metricInit(&s->cores[c], s->window)){
+                fprintf(stderr, "Error: failed to allocate the per-core statistics\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        memcpy(s->core_ids, cores->id, cores->count * sizeof(long int));
+        s->core_count = cores->count;
+    }
+
+    if (first){ return; }
+
+    // Match by id so that a core going offline does not shift the others
+    int c = 0;
+    for (int k = 0; k < cores->count && c < s->core_count; k++){
+        while (c < s->core_count && s->core_ids[c] < cores->id[k]){ c++; }
+        if (c < s->core_count && s->core_ids[c] == cores->id[k]){ metricAdd(&s->cores[c], core_use[k], weight); }
+    }
+}
+
+void statisticsOutput(frame* f, const run_statistics* s){
+    /**
+    * Prints the summary of the run, every metric gets a row for the whole run and one for the sliding window
+    *
+    * @f: frame the output is added to
+    * @s: statistics of the run
+    */
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Summary (window of %d samples) ###\n", s->window);
+    framePrintf(f, " %-10s %-6s %6s %8s %8s %8s %8s %8s %8s %8s\n", "metric", "scope", "n", "min", "max", "mean", "stddev", "p50", "p95", "p99");
+
+    if (s->memory.count > 0){ summaryRows(f, "mem GB", &s->memory); }
+    if (s->cpu.count > 0){ summaryRows(f, "cpu %", &s->cpu); }
+
+    for (int c = 0; c < s->core_count; c++){
+        char name[24];
+        snprintf(name, sizeof(name), "cpu%ld %%", s->core_ids[c]);
+        summaryRows(f, name, &s->cores[c]);
+    }
+}
+
+void statisticsFree(run_statistics* s){
+    /**
+    * Releases the windows of every metric
+    */
+
+    metricFree(&s->memory);
+    metricFree(&s->cpu);
+    for (int c = 0; c < s->core_count; c++){ metricFree(&s->cores[c]); }
+    free(s->cores);
+    free(s->core_ids);
+    s->cores = NULL;
+    s->core_ids = NULL;
+    s->core_count = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+#include "stats_functions.h"
+
+#define SKETCH_BINS 1024
+#define SKETCH_GAMMA 1.02       // relative accuracy of the quantiles is about 1%
+#define SKETCH_MIN_VALUE 1e-4   // smaller values are counted as zero
+
+#define DEFAULT_WINDOW 60
+
+// Quantile sketch with logarithmic buckets, two sketches are merged by adding their counts
+typedef struct sketch {
+
+    uint32_t zero_count;
+    uint32_t counts[SKETCH_BINS];
+    long int total;
+
+} sketch;
+
+// A value of the window with its weight, sorted by value for the quantiles
+typedef struct weighted_value {
+
+    double value;
+    int weight;
+
+} weighted_value;
+
+// Streaming statistics of one metric over the whole run and over the last window samples
+// A sample of weight w counts as w samples of the same value, so unevenly spaced samples are weighted by their interval
+typedef struct metric_stats {
+
+    long int count;
+    long int weight;        // sum of the weights, equal to count when samples are evenly spaced
+    double mean;
+    double m2;              // weighted sum of squared differences from the mean (Welford)
+    double min;
+    double max;
+    sketch quantiles;
+    double* window;
+    int* window_weight;
+    weighted_value* sorted; // scratch copy of the window sorted by metricSummary, allocated with it
+    int window_size;
+    int window_count;
+    int window_head;
+
+} metric_stats;
+
+typedef struct summary_row {
+
+    long int count;
+    double min;
+    double max;
+    double mean;
+    double stddev;
+    double p50;
+    double p95;
+    double p99;
+
+} summary_row;
+
+// Statistics of every metric of a run
+typedef struct run_statistics {
+
+    int window;
+    bool available;             // used memory is total minus available instead of total minus free
+    long long quantum;          // interval that gives a sample a weight of 1, 0 to weigh every sample the same
+    long int samples;           // samples seen so far, the first one only measures the time since boot
+    metric_stats memory;        // used memory in GB
+    metric_stats cpu;           // total cpu utilization in percent
+    metric_stats* cores;        // utilization of every core, allocated when the first per-core sample arrives
+    long int* core_ids;
+    int core_count;
+
+} run_statistics;
+
+void sketchAdd(sketch* s, double value);
+
+void sketchAddCount(sketch* s, double value, uint32_t count);
+
+void sketchMerge(sketch* into, const sketch* from);
+
+double sketchQuantile(const sketch* s, double q);
+
+bool metricInit(metric_stats* m, int window);
+
+void metricAdd(metric_stats* m, double value, int weight);
+
+void metricSummary(const metric_stats* m, summary_row* run, summary_row* window);
+
+void metricFree(metric_stats* m);
+
+bool statisticsInit(run_statistics* s, int window, bool available, long long quantum);
+
+void statisticsAdd(run_statistics* s, long long interval, const sample* current, const cpu_cores* cores, const double* core_use);
+
+void statisticsOutput(frame* f, const run_statistics* s);
+
+void statisticsFree(run_statistics* s);
+
+#endif // STATISTICS_H
@@ -1,14 +1,57 @@
 #include "stats_functions.h"
+#include "collectors.h"
+#include "history.h"
 
-void headerUsage(int samples, int tdelay){
+// Set when the collectors run as threads of the monitor instead of child processes
+bool collectors_threaded = false;
+
+// utmp file read by the user collector, set by --utmp before any collector starts
+const char* utmp_path = _PATH_UTMP;
+
+void terminateCollector(){
+    /**
+    * Terminates a collector after an unrecoverable error
+    *
+    * A collector running in its own process terminates itself and the monitor,
+    * a collector running as a thread only terminates the monitor since its parent is the user's shell
+    */
+
+    kill(getpid(), SIGTERM); // Terminate the current process
+    if (!collectors_threaded){ kill(getppid(), SIGTERM); } // Terminate the parent process
+}
+
+bool readProcFile(proc_file* file, const char* path){
+    /**
+    * Opens a /proc file on first use and reads its current contents into the file's buffer
+    *
+    * @file: proc_file kept by the calling collector between samples
+    * @path: path of the file
+    *
+    * Return: true on success, on failure the collector is terminated and false is returned
+    */
+
+    if (!procOpen(file, path) || procRead(file) == -1) {
+        int error = errno;
+        char mapped[4096];
+        procPath(mapped, sizeof(mapped), path);
+        fprintf(stderr, "Error: failed to read %s. (%s)\n", mapped, strerror(error));
+        terminateCollector();
+        return false;
+    }
+
+    return true;
+}
+
+void headerUsage(frame* f, int samples, double tdelay){
     /**
     * Retrieves and prints the current memory usage in kilobytes
     * 
+    * @f: frame the output is added to
     * @samples: number of samples 
     * @tdelay: time delay between each sample in seconds
     *
     * The function uses the getrusage function from the sys/resource.h library to retrieve information about the memory usage
-    * of the calling process and then prints the result to the terminal.
+    * of the calling process and then adds the result to the frame.
     *
     * Outputs: Nbr of samples: [samples] -- every [tdelay] secs
     *           Memory usage: [used_memory] kilobytes
@@ -29,15 +72,18 @@ void headerUsage(int samples, int tdelay){
     long used_memory = usage.ru_maxrss;
 
     // Print the number of samples, tdelay, and memory usage
-    printf("Nbr of samples: %d -- every %d secs\nMemory usage: %ld kilobytes\n", samples, tdelay, used_memory);
+    framePrintf(f, "Nbr of samples: %d -- every %g secs\nMemory usage: %ld kilobytes\n", samples, tdelay, used_memory);
 
 }
 
-void footerUsage(){
+void footerUsage(frame* f, const struct utsname* host){
     /**
      * Retrives and prints system information
      *
      * The function gets information about the system using uname function from sys/utsname.h library
+     *
+     * @f: frame the output is added to
+     * @host: identity to show, NULL for the host the program runs on
      * 
      * Output:
      * --------------------------------------------
@@ -53,10 +99,9 @@ void footerUsage(){
     
     // Retrive System information
     struct utsname sysinfo;
-    int result = uname(&sysinfo);
-
-    // Check for errors in uname
-    if (result == -1) {
+    if (host != NULL){ sysinfo = *host; }
+    else if (uname(&sysinfo) == -1) {
+        // Check for errors in uname
         fprintf(stderr, "Error: uname failed with error code: %d - %s\n", errno, strerror(errno));
         kill(getpid(), SIGTERM); // Terminate the current process
         kill(getppid(), SIGTERM); // Terminate the parent process
@@ -64,14 +109,14 @@ void footerUsage(){
     }
 
     // Prints relevant information such as system name, machine name, version, release, architecture
-    printf("--------------------------------------------\n");
-    printf("### System Information ###\n");
-    printf(" System Name = %s\n", sysinfo.sysname);
-    printf(" Machine Name = %s\n", sysinfo.nodename);
-    printf(" Version = %s\n", sysinfo.version);
-    printf(" Release = %s\n", sysinfo.release);
-    printf(" Architecture = %s\n", sysinfo.machine);
-    printf("--------------------------------------------\n");
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### System Information ###\n");
+    framePrintf(f, " System Name = %s\n", sysinfo.sysname);
+    framePrintf(f, " Machine Name = %s\n", sysinfo.nodename);
+    framePrintf(f, " Version = %s\n", sysinfo.version);
+    framePrintf(f, " Release = %s\n", sysinfo.release);
+    framePrintf(f, " Architecture = %s\n", sysinfo.machine);
+    framePrintf(f, "--------------------------------------------\n");
 
 }
 
@@ -97,6 +142,7 @@ void memoryGraphicsOutput(char memoryGraphics[1024], double memory_current, doub
     // initialize the stting for viuals and make the length add one for every 0.01 change in memory
     char visual[1024] = "   |";
     int visual_len = (int)( abs_diff / 0.01 );
+    if (visual_len > 512) { visual_len = 512; }
     char last_char;
     char sign;
 
@@ -122,220 +168,536 @@ void memoryGraphicsOutput(char memoryGraphics[1024], double memory_current, doub
     strncat(visual , &last_char, 1);
 
     // Add the graphics to the output string
-    sprintf(memoryGraphics, "%s %.2f (%.2f)", visual, abs_diff, memory_current);
+    if (snprintf(memoryGraphics, 1024, "%s %.2f (%.2f)", visual, abs_diff, memory_current) >= 1024) {
+        memoryGraphics[1023] = '\0';
+    }
 
 }
 
+// Keys of /proc/meminfo used by memoryStats
+enum meminfo_slot { MEMINFO_TOTAL, MEMINFO_FREE, MEMINFO_AVAILABLE, MEMINFO_BUFFERS, MEMINFO_CACHED, MEMINFO_SWAP_CACHED,
+                    MEMINFO_SWAP_TOTAL, MEMINFO_SWAP_FREE, MEMINFO_DIRTY, MEMINFO_WRITEBACK, MEMINFO_SHMEM, MEMINFO_KEYS };
+
+static const struct meminfo_key {
+
+    const char* name;
+    size_t length;
+
+} meminfo_keys[MEMINFO_KEYS] = {
+    { "MemTotal", 8 }, { "MemFree", 7 }, { "MemAvailable", 12 }, { "Buffers", 7 }, { "Cached", 6 }, { "SwapCached", 10 },
+    { "SwapTotal", 9 }, { "SwapFree", 8 }, { "Dirty", 5 }, { "Writeback", 9 }, { "Shmem", 5 }
+};
+
+static int meminfoSlot(const char* key, size_t length, int expected){
+    /**
+    * Finds the slot of a /proc/meminfo key
+    *
+    * @key: start of the key, not null terminated
+    * @length: number of characters before the ':'
+    * @expected: slot of the next key in kernel order, tried first so most lines need a single compare
+    *
+    * Return: the slot, or -1 for a key that is not used
+    */
+
+    if (expected < MEMINFO_KEYS && meminfo_keys[expected].length == length && memcmp(meminfo_keys[expected].name, key, length) == 0){
+        return expected;
+    }
+    for (int k = 0; k < MEMINFO_KEYS; k++){
+        if (meminfo_keys[k].length == length && memcmp(meminfo_keys[k].name, key, length) == 0){ return k; }
+    }
+    return -1;
+}
+
 void memoryStats(int pipefd[2]){
+    /**
+    * Reads the memory figures from /proc/meminfo and writes them to the pipe
+    *
+    * @pipefd: pipe the memory struct is written to
+    *
+    * The file is walked once, every line is split at its ':' and the key looked up by length,
+    * the walk stops as soon as every key has been found
+    */
 
     // Define memory data type
     memory info;
 
-    // Gets memory
-    struct sysinfo memory;
-    int result = sysinfo(&memory);
+    // Re-reads the held open /proc/meminfo
+    static proc_file meminfo_file = PROC_FILE_INIT;
+    if (!readProcFile(&meminfo_file, "/proc/meminfo")){ return; }
+
+    // Values are in kB, MemAvailable is missing before Linux 3.14 and then falls back to free memory
+    long int values[MEMINFO_KEYS] = { 0 };
+    bool seen[MEMINFO_KEYS] = { false };
+    int found = 0, expected = 0;
+    const char* cursor = meminfo_file.buffer;
+    const char* end = meminfo_file.buffer + meminfo_file.length;
+
+    while (cursor < end && found < MEMINFO_KEYS){
+        const char* line_end = procNextLine(cursor, end);
+        const char* colon = memchr(cursor, ':', line_end - cursor);
+
+        if (colon != NULL){
+            int slot = meminfoSlot(cursor, colon - cursor, expected);
+            const char* value = colon + 1;
+            if (slot >= 0 && !seen[slot] && procNextInteger(&value, line_end, &values[slot])){
+                seen[slot] = true;
+                found++;
+                expected = slot + 1;
+            }
+        }
+        cursor = line_end;
+    }
 
-    // Check for errors in sysinfo
-    if (result != 0) {
-        fprintf(stderr, "Error: sysinfo failed with error code: %d - %s\n", errno, strerror(errno));
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+    if (!seen[MEMINFO_TOTAL] || !seen[MEMINFO_FREE]) {
+        fprintf(stderr, "Error: failed to read MemTotal and MemFree from /proc/meminfo\n");
+        terminateCollector();
         return;
     }
+    if (!seen[MEMINFO_AVAILABLE]){ values[MEMINFO_AVAILABLE] = values[MEMINFO_FREE]; }
 
     // Calculate the memory usgae and total memory in GB
-    info.total_memory = (double) memory.totalram / (1024 * 1024 * 1024);
-    info.used_memory =  (double) (memory.totalram - memory.freeram) / (1024 * 1024 * 1024);
-    info.total_virtual = (double) (memory.totalram + memory.totalswap) / (1024 * 1024 * 1024);
-    info.used_virtual = (double) (memory.totalram - memory.freeram + memory.totalswap - memory.freeswap) / (1024 * 1024 * 1024);
-
-    ssize_t bytes_written = write(pipefd[1], &info, sizeof(info));
+    const double kb_per_gb = 1024 * 1024;
+    long int swap_used = values[MEMINFO_SWAP_TOTAL] - values[MEMINFO_SWAP_FREE];
+    info.total_memory = values[MEMINFO_TOTAL] / kb_per_gb;
+    info.used_memory = (values[MEMINFO_TOTAL] - values[MEMINFO_FREE]) / kb_per_gb;
+    info.total_virtual = (values[MEMINFO_TOTAL] + values[MEMINFO_SWAP_TOTAL]) / kb_per_gb;
+    info.used_virtual = (values[MEMINFO_TOTAL] - values[MEMINFO_FREE] + swap_used) / kb_per_gb;
+    info.available = values[MEMINFO_AVAILABLE] / kb_per_gb;
+    info.used_available = (values[MEMINFO_TOTAL] - values[MEMINFO_AVAILABLE]) / kb_per_gb;
+    info.buffers = values[MEMINFO_BUFFERS] / kb_per_gb;
+    info.cached = values[MEMINFO_CACHED] / kb_per_gb;
+    info.shmem = values[MEMINFO_SHMEM] / kb_per_gb;
+    info.dirty = values[MEMINFO_DIRTY] / kb_per_gb;
+    info.writeback = values[MEMINFO_WRITEBACK] / kb_per_gb;
+    info.swap_cached = values[MEMINFO_SWAP_CACHED] / kb_per_gb;
+
+    ssize_t bytes_written = collectorWrite(pipefd, &info, sizeof(info));
 
     if (bytes_written == -1) {
         perror("Error writing to pipe");
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+        terminateCollector();
         return;
     }       
 
 }
 
-void systemOutput(char terminal[1024][1024], bool graphics, int i, double* memory_previous, memory info){
+void systemOutput(frame* f, const history* h, bool graphics, bool sequential, bool available){
     /**
-    * Function Gets memory information of function and stores it in terminal then prints all memory information thus far
-    * Gets information using sysinfo function from sys/sysinfo.h library
+    * Prints the memory information of every sample kept in the history
+    * The information is collected by memoryStats and stored in the history by display
     *
-    * @terminal: array of strings for the output
+    * @f: frame the output is added to
+    * @h: ring buffer of the samples taken so far
     * @graphics: boolean value indicaing if graphics option has been selected
-    * @i: int value indicating the current iteration
-    * @memory_previous: pointer to double that contains the last memory usage calculated
+    * @sequential: boolean value indicating that only the newest sample is printed
+    * @available: boolean value indicating that used memory is total minus available instead of total minus free
     *
+    * Rows are formatted from the numeric samples while printing, nothing is stored as text
+    * The breakdown of the newest sample follows the rows, the graphics show the change of the selected used figure
     */
 
     // Divider
-    printf("--------------------------------------------\n");
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)%s\n", available ? " used = total - available" : "");
 
-    // Gets memory
-    struct sysinfo memory;
-    if (sysinfo(&memory) == -1) {
-        fprintf(stderr, "Error: failed to get system information. (%s)\n", strerror(errno));
-        
-        // Terminate the process and its parent if desired
-        fprintf(stderr, "Error occurred, terminating the process and its parent.\n");
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
-        return;
+    // Sequential output already shows the earlier samples, it only appends the newest one
+    int first = sequential && h->count > 0 ? h->count - 1 : 0;
+    const memory* before = first > 0 ? &historyGet(h, first - 1)->mem : NULL;
+    double memory_previous = before == NULL ? 0 : (available ? before->used_available : before->used_memory);
+
+    for (int k = first; k < h->count; k++){
+        const memory* info = &historyGet(h, k)->mem;
+
+        // The available-based figure leaves out the cache the kernel can drop, swap use is added on top of either
+        double used = available ? info->used_available : info->used_memory;
+        double used_virtual = used + (info->used_virtual - info->used_memory);
+
+        // Format the memmory usage of the sample
+        char row[2048];
+        int len = snprintf(row, 1024, "%.2f GB / %.2f GB -- %.2f GB / %.2f GB", used, info->total_memory, used_virtual, info->total_virtual);
+
+        // If graphics is enabled then add the visual from the graphics function
+        if (graphics){
+            char graphics_output[1024]; memoryGraphicsOutput(graphics_output, used, &memory_previous, k);
+            strcpy(row + len, graphics_output);
+        }
+
+        framePrintf(f, "%s\n", row);
     }
-    
-    
-    // Add the memmory usage to terminal
-    sprintf(terminal[i], "%.2f GB / %.2f GB -- %.2f GB / %.2f GB", info.used_memory, info.total_memory, info.used_virtual, info.total_virtual);
 
-    // If graphics is enabled then add the visual from the graphics function
-    if (graphics){ 
-        char graphics_output[1024]; memoryGraphicsOutput(graphics_output, info.used_memory, memory_previous, i);
-        strcat(terminal[i], graphics_output); 
+    const sample* latest = historyLatest(h);
+    if (latest != NULL){
+        const memory* info = &latest->mem;
+        framePrintf(f, " avail %.2f GB, buffers %.2f GB, cached %.2f GB, shmem %.2f GB, dirty %.2f GB, writeback %.2f GB, swap cached %.2f GB\n",
+                    info->available, info->buffers, info->cached, info->shmem, info->dirty, info->writeback, info->swap_cached);
     }
+}
+
+static bool appendText(char** buffer, size_t* length, size_t* capacity, const char* format, ...){
+    /**
+    * Appends formatted text to a heap buffer, growing it when needed
+    *
+    * Return: false if the buffer could not grow
+    */
+
+    va_list args;
+    while (true){
+        va_start(args, format);
+        int needed = vsnprintf(*buffer == NULL ? NULL : *buffer + *length, *buffer == NULL ? 0 : *capacity - *length, format, args);
+        va_end(args);
+        if (needed < 0){ return false; }
+        if (*buffer != NULL && *length + needed < *capacity){
+            *length += needed;
+            return true;
+        }
 
-    // Prints terminal
-    for (int j = 0; j <= i; j++){
-        printf("%s\n", terminal[j]);
+        size_t larger_capacity = *capacity * 2 + needed + 1024;
+        char* larger = realloc(*buffer, larger_capacity);
+        if (larger == NULL){ return false; }
+        *buffer = larger;
+        *capacity = larger_capacity;
     }
 }
 
-void userOutput(int pipefd[2]){
+static int compareSessions(const void* a, const void* b){
+    // A session is identified by its pid, line and user, the host can be rewritten
+    const session* x = *(const session* const*) a;
+    const session* y = *(const session* const*) b;
+    if (x->pid != y->pid){ return x->pid < y->pid ? -1 : 1; }
+    int line = strcmp(x->line, y->line);
+    return line != 0 ? line : strcmp(x->user, y->user);
+}
+
+static bool sortSessions(session_table* table){
     /**
-    * Prints information about current user sessions
-    * gets information from utmp.h library and prints to each session to terminal
+    * Orders the rows of a parsed table in its sorted array, the rows stay in utmp order for the list
     *
+    * Return: false if the array could not be allocated (a message has been printed)
+    */
+
+    if (table->sorted_capacity < table->count){
+        const session** sorted = realloc(table->sorted, table->capacity * sizeof(session*));
+        if (sorted == NULL){
+            perror("Error allocating the session table");
+            return false;
+        }
+        table->sorted = sorted;
+        table->sorted_capacity = table->capacity;
+    }
+    for (int k = 0; k < table->count; k++){ table->sorted[k] = &table->rows[k]; }
+    qsort(table->sorted, table->count, sizeof(session*), compareSessions);
+    return true;
+}
+
+static bool appendMissing(char** text, size_t* length, size_t* capacity, const session_table* from, const session_table* other, const char* sign){
+    /**
+    * Appends an event line for every session of a table that is not in the other one
+    *
+    * Both tables are sorted, so one merge pass finds them in O(n + m) instead of comparing every pair
+    *
+    * Return: false if the text could not be grown
+    */
+
+    bool ok = true;
+    int j = 0;
+    for (int k = 0; k < from->count; k++){
+        int order = 1;
+        while (j < other->count && (order = compareSessions(&other->sorted[j], &from->sorted[k])) < 0){ j++; }
+        if (j < other->count && order == 0){
+            j++;
+            continue;
+        }
+        const session* s = from->sorted[k];
+        ok &= appendText(text, length, capacity, "%s %s\t %s (%s)\n", sign, s->user, s->line, s->host);
+    }
+    return ok;
+}
+
+static bool parseSessions(session_table* table){
+    /**
+    * Reads the user processes of the utmp file into a table
+    *
+    * Return: false on error (a message has been printed)
     */
 
-    // Initialize and open utmp
     struct utmp *utmp;
-    if (utmpname(_PATH_UTMP) == -1) {
+    if (utmpname(utmp_path) == -1) {
         perror("Error setting utmp file");
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+        return false;
     }
 
+    table->count = 0;
     setutent();
 
     while ((utmp = getutent()) != NULL) {
-        // Check for errors in getutent() -------------------
-
         // Checks for user process
-        if (utmp->ut_type == USER_PROCESS) {
-            // Prints the User, session, host
-            char buffer[1024];
-            snprintf(buffer, sizeof(buffer), "%s\t %s (%s)\n", utmp->ut_user, utmp->ut_line, utmp->ut_host);
-
-            // Write the formatted string to the pipe
-            ssize_t bytes_written = write(pipefd[1], buffer, strlen(buffer));
-            if (bytes_written == -1) {
-                perror("Error writing to pipe");
-                kill(getpid(), SIGTERM); // Terminate the current process
-                kill(getppid(), SIGTERM); // Terminate the parent process
-            }       
+        if (utmp->ut_type != USER_PROCESS) { continue; }
+
+        if (table->count == table->capacity){
+            int capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+            session* rows = realloc(table->rows, capacity * sizeof(session));
+            if (rows == NULL){
+                perror("Error allocating the session table");
+                endutent();
+                return false;
+            }
+            table->rows = rows;
+            table->capacity = capacity;
         }
+
+        // The utmp fields are not null terminated when they fill their whole array
+        session* s = &table->rows[table->count++];
+        snprintf(s->user, sizeof(s->user), "%.*s", (int) sizeof(utmp->ut_user), utmp->ut_user);
+        snprintf(s->line, sizeof(s->line), "%.*s", (int) sizeof(utmp->ut_line), utmp->ut_line);
+        snprintf(s->host, sizeof(s->host), "%.*s", (int) sizeof(utmp->ut_host), utmp->ut_host);
+        s->pid = utmp->ut_pid;
     }
 
-    // Check for errors in endutent()
     endutent();
+    return true;
+}
+
+static bool utmpChanged(int* inotify_fd, int* watch){
+    /**
+    * Tells whether the utmp file may have changed since the previous call
+    *
+    * @inotify_fd: inotify instance, created on the first call
+    * @watch: watch on the utmp file, added again when the file is replaced
+    *
+    * Return: true if the file was modified or replaced, or if it cannot be watched
+    */
+
+    bool changed = false;
+
+    if (*inotify_fd == -1){
+        *inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (*inotify_fd == -1){ return true; }
+    }
+
+    // Drain the pending events, a file replaced by a rename or deleted loses its watch
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(*inotify_fd, events, sizeof(events))) > 0){
+        for (char* p = events; p < events + length; p += sizeof(struct inotify_event) + ((struct inotify_event*) p)->len){
+            const struct inotify_event* event = (const struct inotify_event*) p;
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)){ *watch = -1; }
+            changed = true;
+        }
+    }
 
-    close(pipefd[1]);
+    // The watch is added before the file is parsed so that no change is missed in between
+    if (*watch == -1){
+        *watch = inotify_add_watch(*inotify_fd, utmp_path, IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+        changed = true;
+    }
 
+    return changed;
 }
 
-void cpuStats(int pipefd[2]){
+void userOutput(int pipefd[2]){
+    /**
+    * Sends the user sessions when they changed since the previous sample
+    * gets information from utmp.h library, the file is watched with inotify and only parsed again after it changed
+    *
+    * @pipefd: pipe that receives a users_update header, followed by the login/logout events and the session list if changed is set
+    *
+    * A persistent worker keeps the table of the previous parse and reports the difference as "+ " login and "- " logout lines.
+    * A worker forked for a single sample has no previous table, it always sends the whole list and no events.
+    */
 
-    cpu_stats info;
-    // Gets system info
-    struct sysinfo cpu;
-    if (sysinfo(&cpu) != 0) {
-        fprintf(stderr, "Error: failed to get system info. (%s)\n", strerror(errno));
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+    static session_table current, previous;
+    static bool parsed = false;
+    static int inotify_fd = -1, watch = -1;
+    static char* text = NULL;
+    static size_t text_capacity = 0;
+
+    users_update update;
+    memset(&update, 0, sizeof(update));
+
+    // Most samples stop here, one non-blocking read of the inotify descriptor
+    bool first = !parsed;
+    if (utmpChanged(&inotify_fd, &watch) || first){
+        session_table swap = previous; previous = current; current = swap;
+        if (!parseSessions(&current) || !sortSessions(&current)){
+            terminateCollector();
+            return;
+        }
+        parsed = true;
+
+        size_t length = 0;
+        bool ok = appendText(&text, &length, &text_capacity, "%s", "");
+
+        // Logins are sessions that are new in the table, logouts are sessions that are gone
+        if (!first){
+            ok &= appendMissing(&text, &length, &text_capacity, &current, &previous, "+");
+            ok &= appendMissing(&text, &length, &text_capacity, &previous, &current, "-");
+        }
+        update.events_length = length;
+
+        // A rewrite with the same content is not a change
+        update.changed = first || update.events_length > 0;
+        if (update.changed){
+            for (int k = 0; k < current.count; k++){
+                // Prints the User, session, host
+                ok &= appendText(&text, &length, &text_capacity, "%s\t %s (%s)\n", current.rows[k].user, current.rows[k].line, current.rows[k].host);
+            }
+            update.sessions_length = length - update.events_length;
+            update.sessions = current.count;
+        }
+
+        if (!ok){
+            perror("Error formatting the session list");
+            terminateCollector();
+            return;
+        }
     }
-    
-    // Opens proc stat file with cpu usage
-    FILE *fp = fopen("/proc/stat", "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Error: failed to open /proc/stat. (%s)\n", strerror(errno));
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+
+    if (collectorWrite(pipefd, &update, sizeof(update)) == -1 || (update.changed && collectorWrite(pipefd, text, update.events_length + update.sessions_length) == -1)) {
+        perror("Error writing to pipe");
+        terminateCollector();
     }
 
-    int read_items = fscanf(fp, "cpu %ld %ld %ld %ld %ld %ld %ld", &info.user, &info.nice, &info.system, &info.idle, &info.iowait, &info.irq, &info.softirq);
-    fclose(fp);
+}
+
+static bool readText(collector* c, char** buffer, size_t* capacity, size_t length){
+    /**
+    * Reads length bytes into a heap buffer that is grown when needed, then null terminates them
+    */
 
-    // Checks that all the items have been read
-    if (read_items != 7) {
+    if (*buffer == NULL || *capacity < length + 1){
+        char* larger = realloc(*buffer, length + 1024);
+        if (larger == NULL){ return false; }
+        *buffer = larger;
+        *capacity = length + 1024;
+    }
+
+    if (collectorRead(c, *buffer, length) != (ssize_t) length){ return false; }
+    (*buffer)[length] = '\0';
+    return true;
+}
+
+int readUsers(collector* c, user_sessions* users){
+    /**
+    * Reads one sample written by userOutput
+    *
+    * @c: user collector with a sample ready
+    * @users: session list and last events kept by the monitor, only replaced when the sessions changed
+    *
+    * Return: 1 if the sessions changed, 0 if not, -1 on error
+    */
+
+    users_update update;
+    if (collectorRead(c, &update, sizeof(update)) != sizeof(update)){ return -1; }
+    if (!update.changed){ return 0; }
+
+    if (!readText(c, &users->events, &users->events_capacity, update.events_length)
+        || !readText(c, &users->text, &users->text_capacity, update.sessions_length)){
+        return -1;
+    }
+    users->count = update.sessions;
+    users->changes++;
+
+    return 1;
+}
+
+void cpuStats(int pipefd[2]){
+
+    cpu_stats info;
+
+    // Re-reads the held open /proc/stat
+    static proc_file stat_file = PROC_FILE_INIT;
+    if (!readProcFile(&stat_file, "/proc/stat")){ return; }
+
+    // The first line is "cpu  user nice system idle iowait irq softirq steal guest guest_nice"
+    // Steal and guest time are missing on old kernels, so they default to zero
+    info.steal = 0; info.guest = 0; info.guest_nice = 0;
+    long int* fields[] = { &info.user, &info.nice, &info.system, &info.idle, &info.iowait, &info.irq, &info.softirq, &info.steal, &info.guest, &info.guest_nice };
+    const char* cursor = stat_file.buffer;
+    const char* end = stat_file.buffer + stat_file.length;
+    int read_items = 0;
+
+    if (end - cursor > 4 && strncmp(cursor, "cpu ", 4) == 0){
+        cursor += 4;
+        while (read_items < 10 && procNextInteger(&cursor, end, fields[read_items])){ read_items++; }
+    }
+
+    // Checks that at least the first seven items have been read
+    if (read_items < 7) {
         fprintf(stderr, "Error: failed to read CPU values from /proc/stat. Read %d items instead of 7.\n", read_items);
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+        terminateCollector();
+        return;
+    }
+
+    // The run queue is near the end of the same buffer, after the cpuN, intr and ctxt lines
+    // Lines are skipped with memchr and only the two "procs_" lines are parsed
+    info.procs_running = 0; info.procs_blocked = 0;
+    for (const char* line = procNextLine(cursor, end); line < end; line = procNextLine(line, end)){
+        if (end - line < 14 || strncmp(line, "procs_", 6) != 0){ continue; }
+        const char* value = line + 14;
+        if (strncmp(line + 6, "running ", 8) == 0){ procNextInteger(&value, end, &info.procs_running); }
+        else if (strncmp(line + 6, "blocked ", 8) == 0){
+            procNextInteger(&value, end, &info.procs_blocked);
+            break;
+        }
     }
 
-    ssize_t bytes_written = write(pipefd[1], &info, sizeof(info));
+    ssize_t bytes_written = collectorWrite(pipefd, &info, sizeof(info));
 
     if (bytes_written == -1) {
         perror("Error writing to pipe");
-        kill(getpid(), SIGTERM); // Terminate the current process
-        kill(getppid(), SIGTERM); // Terminate the parent process
+        terminateCollector();
     }  
 
 }
 
-void CPUGraphics(char terminal[1024][1024], double usage, int i){
+void CPUGraphics(frame* f, const history* h, bool sequential){
     /**
     * Prints a graphical representation of CPU usage
     *
-    * @terminal: array of strings that stores the output to print to the terminal
-    * @usage: current cpu usage
-    * @i: current iteration of program
+    * @f: frame the output is added to
+    * @h: ring buffer of the samples taken so far, each holding its cpu usage
+    * @sequential: boolean value indicating that only the newest sample is printed
     *
     * The graphical represntation for usage always starts with '|||' then adds another bar for every percent change in usage
     *
     */
 
-    // Calculates the length of the visual string adding 12 for starting characters
-    int visual_len = (int)(usage) + 12;
+    int first = sequential && h->count > 0 ? h->count - 1 : 0;
 
-    // Creates graphics and stores in terminal
-    strcpy(terminal[i], "         ");
+    for (int k = first; k < h->count; k++){
+        double usage = historyGet(h, k)->cpu_use;
 
-    for (int j = 9; j < visual_len; j++){
-        terminal[i][j] = '|';
-    }
-    terminal[i][visual_len] = '\0';
+        // Calculates the length of the visual string adding 12 for starting characters
+        int visual_len = (int)(usage) + 12;
+
+        // Creates graphics
+        char row[256];
+        strcpy(row, "         ");
+
+        for (int j = 9; j < visual_len; j++){
+            row[j] = '|';
+        }
 
-    // Adds the usage to string
-    sprintf(terminal[i] + visual_len, " %.2f", usage);
+        // Adds the usage to string
+        snprintf(row + visual_len, sizeof(row) - visual_len, " %.2f", usage);
 
-    // Prints history of cpu usage and graphics
-    for (int j = 0; j <= i ; j++){
-        printf("%s\n", terminal[j]);
+        framePrintf(f, "%s\n", row);
     }
 }
 
-void CPUOutput(char terminal[1024][1024], bool graphics, int i, long int* cpu_previous, long int* idle_previous, cpu_stats info){
-
+double cpuUsage(cpu_stats info, long int* cpu_previous, long int* idle_previous){
     /**
-    * Prints information about the current CPU usage of the system
+    * Calculates the CPU usage since the previous sample
     *
-    * @terminal: An array of strings that stores the terminal output
-    * @graphics: A boolean value indicating whether graphics option has been selected
-    * @i: An integer representing the 
+    * @info: cpu counters read from the cpu collector
     * @cpu_previous: A pointer to a long int to store the previous CPU usage 
     * @idle_previous: A pointer to a long int to store the previous idle time
     *
-    * Function gets CPu usage using sysinfo function from sys/sysinfo.h library
-    *
+    * Return: usage in percent, between 0 and 100
     */
 
-    
     // Calculates total usage of cpu
-    long int cpu_total = info.user + info.nice + info.system + info.iowait + info.irq + info.softirq;
+    long int cpu_total = info.user + info.nice + info.system + info.iowait + info.irq + info.softirq + info.steal;
 
     // Cpu value calculations (Same as assignment)
     long int total_prev = *cpu_previous + *idle_previous;
@@ -350,6 +712,26 @@ void CPUOutput(char terminal[1024][1024], bool graphics, int i, long int* cpu_pr
     *cpu_previous = cpu_total;
     *idle_previous = info.idle;
 
+    return cpu_use;
+}
+
+void CPUOutput(frame* f, const history* h, bool graphics, bool sequential){
+
+    /**
+    * Prints information about the current CPU usage of the system
+    *
+    * @f: frame the output is added to
+    * @h: ring buffer of the samples taken so far, the newest one is reported
+    * @graphics: A boolean value indicating whether graphics option has been selected
+    * @sequential: A boolean value indicating that the graphics only show the newest sample
+    *
+    * The usage itself is calculated by cpuUsage when the sample is stored
+    *
+    */
+
+    const sample* latest = historyLatest(h);
+    double cpu_use = latest != NULL ? latest->cpu_use : 0;
+
     // Prints the number of cores and cpu usage
     long int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
     if (num_cores < 0) {
@@ -358,11 +740,173 @@ void CPUOutput(char terminal[1024][1024], bool graphics, int i, long int* cpu_pr
         kill(getppid(), SIGTERM); // Terminate the parent process
     }
 
-    printf("--------------------------------------------\n");
-    printf("Number of Cores: %ld\n", num_cores);
-    printf(" total cpu use: %.2f%%\n", cpu_use);
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "Number of Cores: %ld\n", num_cores);
+    framePrintf(f, " total cpu use: %.2f%%\n", cpu_use);
 
     // If graphics have been slected then call the graphics function to add the visuals
-    if (graphics){ CPUGraphics(terminal, cpu_use, i); }
+    if (graphics){ CPUGraphics(f, h, sequential); }
     
 }
+
+void coreStats(int pipefd[2]){
+    /**
+    * Reads the counters of every cpuN line of /proc/stat and writes them to the pipe
+    *
+    * @pipefd: pipe whose write end receives the core count followed by the ids and each column
+    *
+    * Only the first count entries of each array are sent so the transfer grows with the number of cores
+    */
+
+    cpu_cores cores;
+    cores.count = 0;
+
+    // Re-reads the held open /proc/stat
+    static proc_file stat_file = PROC_FILE_INIT;
+    if (!readProcFile(&stat_file, "/proc/stat")){ return; }
+
+    // Parses every line of the form "cpuN user nice system ...", the aggregate "cpu " line is skipped
+    const char* end = stat_file.buffer + stat_file.length;
+    for (const char* line = stat_file.buffer; line < end && cores.count < MAX_CPUS; line = procNextLine(line, end)){
+        if (end - line < 4 || strncmp(line, "cpu", 3) != 0){ break; }
+        if (!isdigit((unsigned char) line[3])){ continue; }
+
+        const char* cursor = line + 3;
+        int n = cores.count;
+        procNextInteger(&cursor, end, &cores.id[n]);
+        for (int f = 0; f < CORE_FIELDS; f++){
+            cores.field[f][n] = 0;
+            procNextInteger(&cursor, end, &cores.field[f][n]);
+        }
+        cores.count++;
+    }
+
+    // Packs the used part of each column next to each other so the sample is sent with a single write
+    long int packed[(CORE_FIELDS + 1) * MAX_CPUS];
+    int n = cores.count;
+    memcpy(packed, cores.id, n * sizeof(long int));
+    for (int f = 0; f < CORE_FIELDS; f++){
+        memcpy(packed + (f + 1) * n, cores.field[f], n * sizeof(long int));
+    }
+
+    size_t packed_size = (CORE_FIELDS + 1) * n * sizeof(long int);
+    if (collectorWrite(pipefd, &cores.count, sizeof(cores.count)) == -1 || collectorWrite(pipefd, packed, packed_size) != (ssize_t) packed_size) {
+        perror("Error writing to pipe");
+        terminateCollector();
+    }
+}
+
+ssize_t readCores(collector* c, cpu_cores* cores){
+    /**
+    * Reads one sample written by coreStats
+    *
+    * @c: core collector with a sample ready
+    * @cores: structure that receives the per-core counters
+    *
+    * Return: number of bytes read, -1 on error
+    */
+
+    ssize_t bytes_read = collectorRead(c, &cores->count, sizeof(cores->count));
+    if (bytes_read != sizeof(cores->count) || cores->count < 0 || cores->count > MAX_CPUS){
+        cores->count = 0;
+        return -1;
+    }
+
+    int n = cores->count;
+    long int packed[(CORE_FIELDS + 1) * MAX_CPUS];
+    size_t packed_size = (CORE_FIELDS + 1) * n * sizeof(long int);
+    if (collectorRead(c, packed, packed_size) != (ssize_t) packed_size){
+        cores->count = 0;
+        return -1;
+    }
+
+    memcpy(cores->id, packed, n * sizeof(long int));
+    for (int f = 0; f < CORE_FIELDS; f++){
+        memcpy(cores->field[f], packed + (f + 1) * n, n * sizeof(long int));
+    }
+
+    return bytes_read + packed_size;
+}
+
+void coreDeltas(const cpu_cores* cores, core_previous* previous, double usage[MAX_CPUS]){
+    /**
+    * Computes the utilization of every core since the previous sample
+    *
+    * @cores: current per-core counters
+    * @previous: totals and idle times of the previous sample, updated for the next iteration
+    * @usage: array receiving the utilization of each core in percent
+    *
+    * The loop only does arithmetic on whole columns, there are no branches or lookups inside it,
+    * so the compiler can vectorize it and the cost per core stays flat as the core count grows.
+    * Guest time is already part of user time and is therefore not added again.
+    */
+
+    int n = cores->count;
+
+    // A core going offline shifts the columns, in that case every core restarts from zero
+    if (previous->count != n || memcmp(previous->id, cores->id, n * sizeof(long int)) != 0){
+        previous->count = n;
+        memcpy(previous->id, cores->id, n * sizeof(long int));
+        memset(previous->total, 0, n * sizeof(long int));
+        memset(previous->idle, 0, n * sizeof(long int));
+    }
+
+    const long int* restrict user = cores->field[CORE_USER];
+    const long int* restrict nice = cores->field[CORE_NICE];
+    const long int* restrict system = cores->field[CORE_SYSTEM];
+    const long int* restrict idle = cores->field[CORE_IDLE];
+    const long int* restrict iowait = cores->field[CORE_IOWAIT];
+    const long int* restrict irq = cores->field[CORE_IRQ];
+    const long int* restrict softirq = cores->field[CORE_SOFTIRQ];
+    const long int* restrict steal = cores->field[CORE_STEAL];
+    long int* restrict total_previous = previous->total;
+    long int* restrict idle_previous = previous->idle;
+
+    long int total_delta[MAX_CPUS], idle_delta[MAX_CPUS];
+
+    for (int c = 0; c < n; c++){
+        long int total = user[c] + nice[c] + system[c] + idle[c] + iowait[c] + irq[c] + softirq[c] + steal[c];
+        total_delta[c] = total - total_previous[c];
+        idle_delta[c] = idle[c] - idle_previous[c];
+        total_previous[c] = total;
+        idle_previous[c] = idle[c];
+    }
+
+    // Converted in a second pass since there is no packed 64-bit integer to double conversion before AVX-512
+    for (int c = 0; c < n; c++){
+        usage[c] = 100 * (double) (total_delta[c] - idle_delta[c]) / ((double) total_delta[c] + 1e-6);
+    }
+}
+
+void coreOutput(frame* f, bool graphics, const cpu_cores* cores, const double usage[MAX_CPUS]){
+    /**
+    * Prints the utilization of every core
+    *
+    * @f: frame the output is added to
+    * @graphics: boolean value indicating whether graphics option has been selected
+    * @cores: current per-core counters
+    * @usage: utilization of every core computed by coreDeltas
+    *
+    * With graphics a bar is added for every 2 percent of usage so 100% fits in 50 columns
+    */
+
+    framePrintf(f, "--------------------------------------------\n");
+    framePrintf(f, "### Per-core cpu use ###\n");
+
+    for (int c = 0; c < cores->count; c++){
+        double core_use = usage[c];
+        if (core_use < 0){ core_use = 0; }
+        if (core_use > 100){ core_use = 100; }
+
+        if (!graphics){
+            framePrintf(f, " cpu%-4ld %6.2f%%\n", cores->id[c], core_use);
+            continue;
+        }
+
+        char bars[64];
+        int bars_len = (int)(core_use / 2);
+        memset(bars, '|', bars_len);
+        bars[bars_len] = '\0';
+        framePrintf(f, " cpu%-4ld %6.2f%% %s\n", cores->id[c], core_use, bars);
+    }
+}
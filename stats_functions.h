@@ -15,18 +15,33 @@
 #include <signal.h>
 #include <math.h>
 #include <utmp.h>
+#include <sys/inotify.h>
 #include <errno.h>
+#include "procfs.h"
+#include "render.h"
 
+struct collector;     // collectors.h, the readers below take the collector a sample comes from
 
+
+// Memory figures of one sample in GB, read from /proc/meminfo
 typedef struct memory {
 
     double total_memory;
-    double used_memory;
+    double used_memory;         // total minus free, page cache counts as used
     double total_virtual;
     double used_virtual;
+    double available;           // MemAvailable, what can be allocated without swapping
+    double used_available;      // total minus available, page cache that can be dropped is not counted
+    double buffers;
+    double cached;
+    double shmem;
+    double dirty;
+    double writeback;
+    double swap_cached;
 
 } memory;
 
+// Totals of the first line of /proc/stat in clock ticks, with the run queue of the same read
 typedef struct cpu_stats {
     
     long int user;
@@ -36,25 +51,142 @@ typedef struct cpu_stats {
     long int iowait;
     long int irq;
     long int softirq;
+    long int steal;
+    long int guest;
+    long int guest_nice;
+    long int procs_running;     // tasks running or waiting for a cpu at the time of the read
+    long int procs_blocked;     // tasks blocked on I/O
 
 } cpu_stats;
 
-void headerUsage(int samples, int tdelay);
+// One sample of the numeric system information, formatted only when it is rendered
+typedef struct sample {
+
+    long long timestamp;    // wall clock time in nanoseconds
+    long long interval;     // time since the previous sample in nanoseconds, 0 for the first one
+    memory mem;
+    cpu_stats cpu;
+    double cpu_use;         // utilization since the previous sample in percent
+
+} sample;
+
+// Ring buffer holding the most recent samples
+typedef struct history {
+
+    sample* samples;
+    int capacity;
+    int count;
+    int head;               // slot of the next append
+    long int appended;      // number of samples appended since the start
+
+} history;
+
+#define MAX_CPUS 1024
+
+// Columns of a cpuN line in /proc/stat, in file order
+typedef enum core_field {
+
+    CORE_USER, CORE_NICE, CORE_SYSTEM, CORE_IDLE, CORE_IOWAIT,
+    CORE_IRQ, CORE_SOFTIRQ, CORE_STEAL, CORE_GUEST, CORE_GUEST_NICE,
+    CORE_FIELDS
+
+} core_field;
+
+// Per-core counters stored as one array per column so deltas are computed column by column
+typedef struct cpu_cores {
+
+    int count;
+    long int id[MAX_CPUS];
+    long int field[CORE_FIELDS][MAX_CPUS];
+
+} cpu_cores;
+
+typedef struct core_previous {
+
+    int count;
+    long int id[MAX_CPUS];
+    long int total[MAX_CPUS];
+    long int idle[MAX_CPUS];
+
+} core_previous;
+
+// One user session of the utmp file
+typedef struct session {
+
+    char user[UT_NAMESIZE + 1];
+    char line[UT_LINESIZE + 1];
+    char host[UT_HOSTSIZE + 1];
+    pid_t pid;
+
+} session;
 
-void footerUsage();
+typedef struct session_table {
+
+    session* rows;
+    int count;
+    int capacity;
+    const session** sorted;     // rows ordered by pid, line and user, for the login/logout diff
+    int sorted_capacity;
+
+} session_table;
+
+// Header of a sample of the user collector, the event lines and the session list follow it only when changed is set
+typedef struct users_update {
+
+    int changed;
+    int sessions;
+    size_t events_length;
+    size_t sessions_length;
+
+} users_update;
+
+// Session list kept by the monitor between samples
+typedef struct user_sessions {
+
+    char* text;                 // one "user\t line (host)" row per session
+    size_t text_capacity;
+    char* events;               // "+ " login and "- " logout rows of the last change
+    size_t events_capacity;
+    int count;
+    long int changes;           // number of samples in which the sessions changed
+
+} user_sessions;
+
+extern bool collectors_threaded;
+extern const char* utmp_path;
+
+void terminateCollector();
+
+bool readProcFile(proc_file* file, const char* path);
+
+void headerUsage(frame* f, int samples, double tdelay);
+
+void footerUsage(frame* f, const struct utsname* host);
 
 void memoryGraphicsOutput(char memoryGraphics[1024], double memory_current, double* memory_previous, int i);
 
 void memoryStats(int pipefd[2]);
 
-void systemOutput(char terminal[1024][1024], bool graphics, int i, double* memory_previous, memory info);
+void systemOutput(frame* f, const history* h, bool graphics, bool sequential, bool available);
 
 void userOutput(int pipefd[2]);
 
+int readUsers(struct collector* c, user_sessions* users);
+
 void cpuStats(int pipefd[2]);
 
-void CPUGraphics(char terminal[1024][1024], double usage, int i);
+void CPUGraphics(frame* f, const history* h, bool sequential);
+
+double cpuUsage(cpu_stats info, long int* cpu_previous, long int* idle_previous);
+
+void CPUOutput(frame* f, const history* h, bool graphics, bool sequential);
+
+void coreStats(int pipefd[2]);
+
+ssize_t readCores(struct collector* c, cpu_cores* cores);
+
+void coreDeltas(const cpu_cores* cores, core_previous* previous, double usage[MAX_CPUS]);
 
-void CPUOutput(char terminal[1024][1024], bool graphics, int i, long int* cpu_previous, long int* idle_previous, cpu_stats info);
+void coreOutput(frame* f, bool graphics, const cpu_cores* cores, const double usage[MAX_CPUS]);
 
 #endif // STATS_FUNCTIONS_H